@@ -37,6 +37,9 @@ std::stringstream &error_messages();
 std::string id_to_name(uint32_t lexer_id);
 xl::TreeContext* &tree_context();
 
-xl::node::NodeIdentIFace* make_ast(xl::Allocator &alloc);
+// takes each top-level statement as soon as it is parsed, see make_ast
+typedef void (*stmt_cb_t)(const xl::node::NodeIdentIFace* stmt, void* arg);
+
+xl::node::NodeIdentIFace* make_ast(xl::Allocator &alloc, stmt_cb_t stmt_cb = NULL, void* stmt_arg = NULL);
 
 #endif
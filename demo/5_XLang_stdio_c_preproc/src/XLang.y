@@ -148,6 +148,22 @@ xl::TreeContext* &tree_context()
 
 std::string _dirname;
 
+// set by make_ast
+stmt_cb_t _stmt_cb = NULL;
+void*     _stmt_arg = NULL;
+
+// Without a statement callback, returns stmt for the program tree. Else hands it to the
+// callback and releases it with its arena, then pushes the next statement's arena.
+xl::node::NodeIdentIFace* emit_stmt(xl::node::NodeIdentIFace* stmt)
+{
+    if(!_stmt_cb)
+        return stmt;
+    _stmt_cb(stmt, _stmt_arg);
+    tree_context()->pop_arena();
+    tree_context()->push_arena();
+    return NULL;
+}
+
 %}
 
 // type of yylval to be set by scanner actions
@@ -168,7 +184,7 @@ std::string _dirname;
 %token<int_value>   ID_INT
 %token<float_value> ID_FLOAT
 %token<ident_value> ID_IDENT ID_TYPE ID_FUNC ID_VAR ID_PREPROC_SYM
-%type<symbol_value> block stmt expr
+%type<symbol_value> program block stmt expr
 %type<symbol_value> decl struct_decl func_decl var_decl
 %type<symbol_value> opt_elif_stmt_list elif_stmt_list elif_stmt
 %type<symbol_value> opt_ident_list ident_list
@@ -183,8 +199,14 @@ std::string _dirname;
 %%
 
 root:
-      block { tree_context()->root() = $1; YYACCEPT; }
-    | error { yyclearin; /* yyerrok; YYABORT; */ }
+      program { tree_context()->root() = $1; YYACCEPT; }
+    | error   { yyclearin; /* yyerrok; YYABORT; */ }
+    ;
+
+// a block at the top level, its statements can be released one at a time
+program:
+      stmt         { $$ = emit_stmt($1); }
+    | program stmt { $$ = _stmt_cb ? emit_stmt($2) : MAKE_SYMBOL(';', 2, $1, $2); }
     ;
 
 block:
@@ -301,12 +323,36 @@ var_decl:
 
 %%
 
-xl::node::NodeIdentIFace* make_ast(xl::Allocator &alloc)
+// With a statement callback, each top-level statement is built in its own child arena, and
+// released once the callback returns. The program tree is not kept, so NULL is returned.
+xl::node::NodeIdentIFace* make_ast(xl::Allocator &alloc, stmt_cb_t stmt_cb, void* stmt_arg)
 {
     tree_context() = new (PNEW(alloc, xl::, TreeContext)) xl::TreeContext(alloc);
-    int error_code = yyparse(); // parser entry point
+    xl::TreeContext::mark_t mark = tree_context()->mark();
+    _stmt_cb = stmt_cb;
+    _stmt_arg = stmt_arg;
+    if(stmt_cb)
+        tree_context()->push_arena();
+    int error_code = 0;
+    try
+    {
+        error_code = yyparse(); // parser entry point
+    }
+    catch(const xl::BudgetExceeded &e)
+    {
+        error_messages() << e.what();
+        error_code = 1;
+    }
     yylex_destroy(); // NOTE: necessary to avoid memory leak
-    return (!error_code && error_messages().str().empty()) ? tree_context()->root() : NULL;
+    if(error_code || !error_messages().str().empty())
+    {
+        tree_context()->rollback(mark); // release nodes built along abandoned paths
+        return NULL;
+    }
+    if(stmt_cb)
+        tree_context()->pop_arena();
+    tree_context()->commit(mark);
+    return tree_context()->root();
 }
 
 void display_usage(bool verbose)
@@ -326,8 +372,13 @@ void display_usage(bool verbose)
                 << "  -x, --xml" << std::endl
                 << "  -g, --graph" << std::endl
                 << "  -d, --dot" << std::endl
+                << "  -s, --stream (print each statement as soon as it is parsed)" << std::endl
                 << "  -m, --memory" << std::endl
-                << "  -h, --help" << std::endl;
+                << "  -h, --help" << std::endl
+                << std::endl
+                << "Limits:" << std::endl
+                << "  -b, --max-bytes BYTES (abort the parse beyond this many live bytes)" << std::endl
+                << "  -n, --max-nodes COUNT (abort the parse beyond this many allocations)" << std::endl;
     }
     else
         std::cout << "Try `XLang --help\' for more information." << std::endl;
@@ -349,10 +400,14 @@ struct options_t
     mode_e      mode;
     std::string in_file;
     std::string in_xml;
+    bool        stream;
     bool        dump_memory;
+    size_t      max_bytes;
+    size_t      max_nodes;
 
     options_t()
-        : mode(MODE_NONE), dump_memory(false)
+        : mode(MODE_NONE), stream(false), dump_memory(false),
+          max_bytes(static_cast<size_t>(-1)), max_nodes(static_cast<size_t>(-1))
     {}
 };
 
@@ -362,18 +417,21 @@ bool extract_options_from_args(options_t* options, int argc, char** argv)
         return false;
     int opt = 0;
     int longIndex = 0;
-    static const char *optString = "i:f:elxgdmh?";
+    static const char *optString = "i:f:elxgdsmb:n:h?";
     static const struct option longOpts[] = {
-                { "in-xml",  required_argument, NULL, 'i' },
-                { "in-file", required_argument, NULL, 'f' },
-                { "eval",    no_argument,       NULL, 'e' },
-                { "lisp",    no_argument,       NULL, 'l' },
-                { "xml",     no_argument,       NULL, 'x' },
-                { "graph",   no_argument,       NULL, 'g' },
-                { "dot",     no_argument,       NULL, 'd' },
-                { "memory",  no_argument,       NULL, 'm' },
-                { "help",    no_argument,       NULL, 'h' },
-                { NULL,      no_argument,       NULL, 0 }
+                { "in-xml",    required_argument, NULL, 'i' },
+                { "in-file",   required_argument, NULL, 'f' },
+                { "eval",      no_argument,       NULL, 'e' },
+                { "lisp",      no_argument,       NULL, 'l' },
+                { "xml",       no_argument,       NULL, 'x' },
+                { "graph",     no_argument,       NULL, 'g' },
+                { "dot",       no_argument,       NULL, 'd' },
+                { "stream",    no_argument,       NULL, 's' },
+                { "memory",    no_argument,       NULL, 'm' },
+                { "max-bytes", required_argument, NULL, 'b' },
+                { "max-nodes", required_argument, NULL, 'n' },
+                { "help",      no_argument,       NULL, 'h' },
+                { NULL,        no_argument,       NULL, 0 }
             };
     opt = getopt_long(argc, argv, optString, longOpts, &longIndex);
     while(opt != -1)
@@ -387,7 +445,10 @@ bool extract_options_from_args(options_t* options, int argc, char** argv)
             case 'x': options->mode = options_t::MODE_XML; break;
             case 'g': options->mode = options_t::MODE_GRAPH; break;
             case 'd': options->mode = options_t::MODE_DOT; break;
+            case 's': options->stream = true; break;
             case 'm': options->dump_memory = true; break;
+            case 'b': options->max_bytes = strtoul(optarg, NULL, 10); break;
+            case 'n': options->max_nodes = strtoul(optarg, NULL, 10); break;
             case 'h':
             case '?': options->mode = options_t::MODE_HELP; break;
             case 0: // reserved
@@ -399,6 +460,8 @@ bool extract_options_from_args(options_t* options, int argc, char** argv)
     return options->mode != options_t::MODE_NONE || options->dump_memory;
 }
 
+void export_stmt(const xl::node::NodeIdentIFace* stmt, void* arg);
+
 bool import_ast(options_t &options, xl::Allocator &alloc, xl::node::NodeIdentIFace* &ast)
 {
     if(options.in_xml.size())
@@ -421,8 +484,8 @@ bool import_ast(options_t &options, xl::Allocator &alloc, xl::node::NodeIdentIFa
             return false;
         }
         _dirname = dirname(const_cast<char*>(options.in_file.c_str()));
-        ast = make_ast(alloc);
-        if(!ast)
+        ast = make_ast(alloc, options.stream ? export_stmt : NULL, &options);
+        if(!ast && !(options.stream && error_messages().str().empty())) // a stream returns no tree
         {
             std::cerr << "ERROR: " << error_messages().str().c_str() << std::endl;
             return false;
@@ -445,6 +508,14 @@ void export_ast(options_t &options, const xl::node::NodeIdentIFace* ast)
     }
 }
 
+// the symbol table is only printed once, at the end
+void export_stmt(const xl::node::NodeIdentIFace* stmt, void* arg)
+{
+    options_t &options = *static_cast<options_t*>(arg);
+    if(options.mode != options_t::MODE_EVAL)
+        export_ast(options, stmt);
+}
+
 bool apply_options(options_t &options)
 {
     try
@@ -454,11 +525,14 @@ bool apply_options(options_t &options)
             display_usage(true);
             return true;
         }
-        xl::Allocator alloc(__FILE__);
+        xl::Allocator alloc(__FILE__, options.dump_memory ?
+                xl::Allocator::MODE_TRACKING : xl::Allocator::MODE_ARENA);
+        alloc.set_budget(options.max_bytes, options.max_nodes);
         xl::node::NodeIdentIFace* ast = NULL;
         if(!import_ast(options, alloc, ast))
             return false;
-        export_ast(options, ast);
+        if(ast || options.mode == options_t::MODE_EVAL)
+            export_ast(options, ast);
         if(options.dump_memory)
             alloc.dump(std::string(1, '\t'));
     }
@@ -467,6 +541,11 @@ bool apply_options(options_t &options)
         std::cerr << "ERROR: " << s << std::endl;
         return false;
     }
+    catch(const xl::BudgetExceeded &e)
+    {
+        std::cerr << "ERROR: " << e.what() << std::endl;
+        return false;
+    }
     return true;
 }
 
@@ -195,9 +195,25 @@ var_decl:
 xl::node::NodeIdentIFace* make_ast(xl::Allocator &alloc)
 {
     tree_context() = new (PNEW(alloc, xl::, TreeContext)) xl::TreeContext(alloc);
-    int error_code = yyparse(); // parser entry point
+    xl::TreeContext::mark_t mark = tree_context()->mark();
+    int error_code = 0;
+    try
+    {
+        error_code = yyparse(); // parser entry point
+    }
+    catch(const xl::BudgetExceeded &e)
+    {
+        error_messages() << e.what();
+        error_code = 1;
+    }
     yylex_destroy(); // NOTE: necessary to avoid memory leak
-    return (!error_code && error_messages().str().empty()) ? tree_context()->root() : NULL;
+    if(error_code || !error_messages().str().empty())
+    {
+        tree_context()->rollback(mark); // release nodes built along abandoned paths
+        return NULL;
+    }
+    tree_context()->commit(mark);
+    return tree_context()->root();
 }
 
 void display_usage(bool verbose)
@@ -217,7 +233,11 @@ void display_usage(bool verbose)
                 << "  -g, --graph" << std::endl
                 << "  -d, --dot" << std::endl
                 << "  -m, --memory" << std::endl
-                << "  -h, --help" << std::endl;
+                << "  -h, --help" << std::endl
+                << std::endl
+                << "Limits:" << std::endl
+                << "  -b, --max-bytes BYTES (abort the parse beyond this many live bytes)" << std::endl
+                << "  -n, --max-nodes COUNT (abort the parse beyond this many allocations)" << std::endl;
     }
     else
         std::cout << "Try `XLang --help\' for more information." << std::endl;
@@ -239,9 +259,12 @@ struct options_t
     mode_e      mode;
     std::string in_xml;
     bool        dump_memory;
+    size_t      max_bytes;
+    size_t      max_nodes;
 
     options_t()
-        : mode(MODE_NONE), dump_memory(false)
+        : mode(MODE_NONE), dump_memory(false),
+          max_bytes(static_cast<size_t>(-1)), max_nodes(static_cast<size_t>(-1))
     {}
 };
 
@@ -251,17 +274,19 @@ bool extract_options_from_args(options_t* options, int argc, char** argv)
         return false;
     int opt = 0;
     int longIndex = 0;
-    static const char *optString = "i:elxgdmh?";
+    static const char *optString = "i:elxgdmb:n:h?";
     static const struct option longOpts[] = {
-                { "in-xml", required_argument, NULL, 'i' },
-                { "eval",   no_argument,       NULL, 'e' },
-                { "lisp",   no_argument,       NULL, 'l' },
-                { "xml",    no_argument,       NULL, 'x' },
-                { "graph",  no_argument,       NULL, 'g' },
-                { "dot",    no_argument,       NULL, 'd' },
-                { "memory", no_argument,       NULL, 'm' },
-                { "help",   no_argument,       NULL, 'h' },
-                { NULL,     no_argument,       NULL, 0 }
+                { "in-xml",    required_argument, NULL, 'i' },
+                { "eval",      no_argument,       NULL, 'e' },
+                { "lisp",      no_argument,       NULL, 'l' },
+                { "xml",       no_argument,       NULL, 'x' },
+                { "graph",     no_argument,       NULL, 'g' },
+                { "dot",       no_argument,       NULL, 'd' },
+                { "memory",    no_argument,       NULL, 'm' },
+                { "max-bytes", required_argument, NULL, 'b' },
+                { "max-nodes", required_argument, NULL, 'n' },
+                { "help",      no_argument,       NULL, 'h' },
+                { NULL,        no_argument,       NULL, 0 }
             };
     opt = getopt_long(argc, argv, optString, longOpts, &longIndex);
     while(opt != -1)
@@ -275,6 +300,8 @@ bool extract_options_from_args(options_t* options, int argc, char** argv)
             case 'g': options->mode = options_t::MODE_GRAPH; break;
             case 'd': options->mode = options_t::MODE_DOT; break;
             case 'm': options->dump_memory = true; break;
+            case 'b': options->max_bytes = strtoul(optarg, NULL, 10); break;
+            case 'n': options->max_nodes = strtoul(optarg, NULL, 10); break;
             case 'h':
             case '?': options->mode = options_t::MODE_HELP; break;
             case 0: // reserved
@@ -334,7 +361,9 @@ bool apply_options(options_t &options)
             display_usage(true);
             return true;
         }
-        xl::Allocator alloc(__FILE__);
+        xl::Allocator alloc(__FILE__, options.dump_memory ?
+                xl::Allocator::MODE_TRACKING : xl::Allocator::MODE_ARENA);
+        alloc.set_budget(options.max_bytes, options.max_nodes);
         xl::node::NodeIdentIFace* ast = NULL;
         if(!import_ast(options, alloc, ast))
             return false;
@@ -347,6 +376,11 @@ bool apply_options(options_t &options)
         std::cerr << "ERROR: " << s << std::endl;
         return false;
     }
+    catch(const xl::BudgetExceeded &e)
+    {
+        std::cerr << "ERROR: " << e.what() << std::endl;
+        return false;
+    }
     return true;
 }
 
@@ -19,9 +19,18 @@
 #define XLANG_ALLOC_H_
 
 #include <map> // std::map
+#include <unordered_map> // std::unordered_map
 #include <string> // std::string
 #include <stddef.h> // size_t
 #include <list> // std::list
+#include <vector> // std::vector
+#include <stdint.h> // uint32_t
+#include <deque> // std::deque
+#include <mutex> // std::mutex
+#include <atomic> // std::atomic
+#include <thread> // std::thread::id
+#include <new> // std::bad_alloc
+#include <algorithm> // std::min
 
 #define DTOR_CB(ns, c) [](void* x) {      \
         reinterpret_cast<ns c*>(x)->~c(); \
@@ -30,61 +39,382 @@
         reinterpret_cast<ns c*>(x)->~f();  \
         }
 
+// Building everything with -DXLANG_NO_ALLOC_TRACKING compiles out MODE_TRACKING, so PNEW
+// passes no allocation site and the arena fast path inlines down to a bump allocation.
+#ifdef XLANG_NO_ALLOC_TRACKING
+    #define PNEW_SITE NULL, 0
+#else
+    #define PNEW_SITE __FILE__, __LINE__
+#endif
+
 #define PNEW_LOC(a) \
-        (a), __FILE__, __LINE__
+        (a), PNEW_SITE
 
 #define PNEW(a, ns, c) \
         PNEW_LOC(a), DTOR_CB(ns, c)
 #define PNEW_EX(a, ns, c, f) \
         PNEW_LOC(a), DTOR_CB_EX(ns, c, f)
 
+// for arrays of types with trivial dtors
+#define PNEW_ARRAY(a, c, n) \
+        reinterpret_cast<c*>((a)._malloc(sizeof(c)*(n), PNEW_SITE))
+
 namespace xl {
 
+typedef void (*dtor_cb_t)(void*);
+
+// one record per distinct (filename, line number, dtor) allocation site
+struct AllocSite
+{
+    const char* m_filename;
+    size_t      m_line_number;
+    dtor_cb_t   m_dtor_cb;
+    size_t      m_alloc_count;
+    size_t      m_alloc_bytes;
+    size_t      m_live_count;
+    size_t      m_live_bytes;
+    size_t      m_peak_bytes;
+
+    AllocSite(const char* _filename, size_t _line_number, dtor_cb_t _dtor_cb)
+        : m_filename(_filename), m_line_number(_line_number), m_dtor_cb(_dtor_cb),
+          m_alloc_count(0), m_alloc_bytes(0), m_live_count(0), m_live_bytes(0), m_peak_bytes(0)
+    {}
+    void dump(std::string indent) const;
+};
+
 class MemChunk
 {
 public:
-    typedef void (*dtor_cb_t)(void*);
+    typedef xl::dtor_cb_t dtor_cb_t;
 
-    MemChunk(size_t _size_bytes, std::string _filename, size_t _line_number, dtor_cb_t dtor_cb = NULL);
+    MemChunk(size_t _size_bytes, AllocSite* _site, size_t _serial);
     ~MemChunk();
     void* ptr() const { return m_ptr; }
+    void* release() // the memory is no longer the chunk's, and its dtor won't run
+    {
+        void* _ptr = m_ptr;
+        m_ptr = NULL;
+        return _ptr;
+    }
     size_t size() const { return m_size_bytes; }
-    std::string filename() const { return m_filename; }
-    size_t line_number() const { return m_line_number; }
+    size_t serial() const { return m_serial; }
+    std::string filename() const { return m_site->m_filename; }
+    size_t line_number() const { return m_site->m_line_number; }
     void dump(std::string indent) const;
 
 private:
-    size_t m_size_bytes;
-    std::string m_filename;
-    size_t m_line_number;
-    dtor_cb_t m_dtor_cb;
-    void* m_ptr;
+    size_t     m_size_bytes;
+    AllocSite* m_site;
+    size_t     m_serial; // allocation order, for rollback
+    void*      m_ptr;
+};
+
+// thrown by Allocator::_malloc when an allocation would go over budget
+class BudgetExceeded : public std::bad_alloc
+{
+public:
+    BudgetExceeded(bool _chunk_budget)
+        : m_chunk_budget(_chunk_budget)
+    {}
+    const char* what() const throw()
+    {
+        return m_chunk_budget ? "allocation count budget exceeded" : "memory budget exceeded";
+    }
+
+private:
+    bool m_chunk_budget;
 };
 
 class Allocator
 {
 public:
-    Allocator(std::string _filename);
+    typedef enum
+    {
+        MODE_TRACKING, // one malloc per chunk, each tracked with its filename and line number
+                       // (same as MODE_ARENA under XLANG_NO_ALLOC_TRACKING)
+        MODE_ARENA     // size-class pools carved from large pages, only chunks with a dtor are tracked
+    } mode_e;
+
+    typedef enum
+    {
+        BLOCK_MALLOC,   // posix_memalign
+        BLOCK_MMAP,     // anonymous mmap, returned with munmap
+        BLOCK_MMAP_HUGE // same, aligned and advised for transparent huge pages
+    } block_source_e;
+
+    static const size_t PAGE_SIZE_BYTES  = 64*1024; // default block size
+    static const size_t HUGE_PAGE_SIZE_BYTES = 2*1024*1024;
+    static const size_t SLAB_SIZE_BYTES  = 4*1024; // one size class per slab
+    static const size_t ALIGN_BYTES      = 16;
+    static const size_t MAX_POOLED_BYTES = 512;    // larger chunks are allocated individually
+    static const size_t SIZE_CLASS_COUNT = 20;
+
+    typedef size_t mark_t;
+
+    Allocator(std::string _name, mode_e _mode = MODE_ARENA, bool _concurrent = false);
+    Allocator(std::string _name, Allocator &_parent);
     ~Allocator();
     std::string name() const { return m_name; }
-    size_t size() const { return m_size_bytes; }
-    void* _malloc(size_t size_bytes, std::string filename, size_t line_number, MemChunk::dtor_cb_t dtor_cb = NULL);
-    void _free(void* ptr);
+    mode_e mode() const { return m_mode; }
+    Allocator* parent() const { return m_parent; }
+    bool concurrent() const { return m_concurrent; }
+    size_t size() const { return m_concurrent ? _local_size() : m_size_bytes; }
+    void set_budget(size_t max_bytes, size_t max_chunks = static_cast<size_t>(-1));
+    bool set_block_source(block_source_e block_source, size_t block_size_bytes = PAGE_SIZE_BYTES,
+            bool prefault = false);
+    void* _malloc(size_t size_bytes, const char* filename, size_t line_number, MemChunk::dtor_cb_t dtor_cb = NULL)
+    {
+        if(m_concurrent)
+            return _malloc_concurrent(size_bytes, filename, line_number, dtor_cb);
+        if(m_root->_has_budget())
+            m_root->_take_budget(*this, size_bytes);
+#ifndef XLANG_NO_ALLOC_TRACKING
+        if(m_mode == MODE_TRACKING)
+            return _malloc_tracking(size_bytes, filename, line_number, dtor_cb);
+#endif
+        m_chunk_serial++;
+        return _malloc_arena(size_bytes, dtor_cb);
+    }
+    void* _realloc(void* ptr, size_t size_bytes, const char* filename, size_t line_number);
+    size_t capacity(const void* ptr);
+    void _free(void* ptr, bool run_dtor = true);
     void _free();
+    void reset(size_t max_retained_bytes = static_cast<size_t>(-1));
+    mark_t mark();
+    void rollback(mark_t _mark);
+    void commit(mark_t _mark);
     void dump(std::string indent) const;
 
 private:
+    // at the start of every slab and every large chunk, found by masking a chunk address
+    struct SlabHeader
+    {
+        uint16_t    m_size_class; // SIZE_CLASS_COUNT for large chunks
+        uint16_t    m_has_dtor;
+        uint32_t    m_serial;     // carving order, for rollback
+        size_t      m_size_bytes; // slot size, or usable size for large chunks
+        SlabHeader* m_prev;       // large chunks only
+        SlabHeader* m_next;
+        Allocator*  m_owner;      // the arena a chunk freed by another thread goes back to
+    };
+    // in front of every chunk that has a dtor
+    struct DtorLink
+    {
+        DtorLink*           m_prev;
+        DtorLink*           m_next;
+        MemChunk::dtor_cb_t m_dtor_cb;
+    };
+    struct Pool
+    {
+        char* m_cur; // bump pointer into the current slab
+        char* m_end;
+        void* m_free_list;
+    };
+    // allocator state at mark time, chunks allocated since then are released by rollback
+    struct MarkState
+    {
+        size_t      m_page_index;
+        char*       m_slab_cur;
+        char*       m_slab_end;
+        uint32_t    m_serial;
+        size_t      m_chunk_serial;
+        size_t      m_size_bytes;
+        size_t      m_premark_freed_bytes; // freed since the mark, but allocated before it
+        Pool        m_pool[2][SIZE_CLASS_COUNT]; // free lists are stashed here until the mark is resolved
+        void*       m_deferred_list[2][SIZE_CLASS_COUNT]; // slots allocated before the mark, freed since
+        DtorLink    m_dtor_sentinel;  // dtor chunks in front of it were allocated since the mark
+        SlabHeader  m_large_sentinel; // same for large chunks
+    };
+    static const size_t SLAB_HEADER_BYTES = (sizeof(SlabHeader)+ALIGN_BYTES-1) & ~(ALIGN_BYTES-1);
+    static const size_t DTOR_LINK_BYTES   = (sizeof(DtorLink)+ALIGN_BYTES-1) & ~(ALIGN_BYTES-1);
+    struct site_key_t
+    {
+        const char* m_filename;
+        size_t      m_line_number;
+        dtor_cb_t   m_dtor_cb;
+
+        bool operator==(const site_key_t &other) const
+        {
+            return m_filename == other.m_filename && m_line_number == other.m_line_number &&
+                    m_dtor_cb == other.m_dtor_cb;
+        }
+    };
+    struct site_key_hash_t
+    {
+        size_t operator()(const site_key_t &key) const
+        {
+            return reinterpret_cast<size_t>(key.m_filename)*31+key.m_line_number;
+        }
+    };
+    // concurrent tracking mode, where a chunk has no slab header
+    struct OwnedChunk
+    {
+        Allocator* m_owner;
+        dtor_cb_t  m_dtor_cb;
+        size_t     m_size_bytes;
+    };
     typedef std::map<void*, MemChunk*> internal_type_t;
-    std::string m_name;
+    typedef std::unordered_map<site_key_t, AllocSite, site_key_hash_t> site_map_t;
+
+    std::string     m_name;
+    mode_e          m_mode;
+    Allocator*      m_parent; // child arenas take pages from, and return them to, their parent
+    Allocator*      m_root;   // keeps the budget, for itself and every arena made from it
+    bool            m_concurrent;
+    size_t          m_id;     // changes on reset, so per-thread caches can tell a stale entry
     internal_type_t m_chunk_map;
-    size_t m_size_bytes;
+    site_map_t      m_site_map; // keyed by __FILE__ address, merged by name in dump
+    size_t          m_size_bytes;
+    size_t          m_max_bytes;
+    size_t          m_max_chunks;
+
+    // arena mode
+    block_source_e     m_block_source;
+    size_t             m_page_size_bytes;
+    bool               m_prefault;
+    size_t             m_block_count; // pages this allocator got from the system
+    std::vector<void*> m_page_vec;   // in use and retained pages
+    size_t             m_page_index; // pages in use
+    char*              m_slab_cur;   // next unused slab in the current page
+    char*              m_slab_end;
+    Pool               m_pool[2][SIZE_CLASS_COUNT]; // indexed by has_dtor, size class
+    SlabHeader*        m_large_list;
+    SlabHeader*        m_large_free_list; // retained by reset
+    DtorLink*          m_dtor_list; // most recent first
+    size_t             m_dtor_count;
+    size_t             m_large_count;
+    uint32_t           m_serial; // slabs and large chunks carved so far
+
+    size_t                m_chunk_serial; // allocations since reset, orders tracking mode chunks
+    std::deque<MarkState> m_mark_stack;   // innermost last, never reallocated since sentinels are linked in
+
+    // concurrent mode, each thread allocates from its own child arena
+    typedef std::map<std::thread::id, Allocator*> local_map_t;
+    typedef std::unordered_map<void*, OwnedChunk> owner_map_t;
+    mutable std::mutex  m_mutex; // guards m_local_map, m_owner_map, and the pages handed out to children
+    local_map_t         m_local_map;
+    owner_map_t         m_owner_map; // tracking mode only
+    bool                m_resetting; // chunks freed by dtors during reset are released with the rest
+    std::atomic<size_t> m_shared_size_bytes;  // usage of the root and all its arenas, kept while there is a budget
+    std::atomic<size_t> m_shared_chunk_count;
+    size_t              m_charged_size_bytes; // this arena's usage as last added to its root's
+    size_t              m_charged_chunk_count;
+    std::atomic<void*>  m_remote_free_list; // chunks freed by other threads, linked through their first word
+
+    Allocator &_local();
+    size_t _local_size() const;
+    bool _has_budget() const
+    {
+        return m_max_bytes != static_cast<size_t>(-1) || m_max_chunks != static_cast<size_t>(-1);
+    }
+    void* _malloc_concurrent(size_t size_bytes, const char* filename, size_t line_number,
+            MemChunk::dtor_cb_t dtor_cb);
+    void _free_concurrent(void* ptr, bool run_dtor);
+    void _take_budget(Allocator &alloc, size_t size_bytes);
+    void _charge(Allocator &alloc);
+    void _push_remote_free(void* ptr);
+    void _drain_remote_frees()
+    {
+        if(m_remote_free_list.load(std::memory_order_relaxed))
+            _free_remote();
+    }
+    void _free_remote();
+    AllocSite* _intern_site(const char* filename, size_t line_number, MemChunk::dtor_cb_t dtor_cb);
+    void* _malloc_tracking(size_t size_bytes, const char* filename, size_t line_number,
+            MemChunk::dtor_cb_t dtor_cb);
+
+    // inlined, so the common case is a free list pop or a pointer bump
+    void* _malloc_arena(size_t size_bytes, MemChunk::dtor_cb_t dtor_cb)
+    {
+        bool has_dtor = (dtor_cb != NULL);
+        size_t slot_size_bytes = (has_dtor ? DTOR_LINK_BYTES : 0)+(size_bytes ? size_bytes : 1);
+        char* slot = NULL;
+        if(slot_size_bytes > MAX_POOLED_BYTES)
+            slot = reinterpret_cast<char*>(_alloc_large(slot_size_bytes, has_dtor));
+        else
+            slot = reinterpret_cast<char*>(_alloc_slot(size_class_of(slot_size_bytes), has_dtor));
+        if(!has_dtor)
+            return slot;
+        DtorLink* link = reinterpret_cast<DtorLink*>(slot);
+        link->m_prev = NULL;
+        link->m_next = m_dtor_list;
+        link->m_dtor_cb = dtor_cb;
+        if(m_dtor_list)
+            m_dtor_list->m_prev = link;
+        m_dtor_list = link;
+        m_dtor_count++;
+        return slot+DTOR_LINK_BYTES;
+    }
+    void* _alloc_slot(size_t size_class, bool has_dtor)
+    {
+        Pool &pool = m_pool[has_dtor][size_class];
+        size_t slot_size_bytes = size_of_class(size_class);
+        m_size_bytes += slot_size_bytes;
+        if(pool.m_free_list)
+        {
+            void* slot = pool.m_free_list;
+            pool.m_free_list = *reinterpret_cast<void**>(slot);
+            return slot;
+        }
+        if(pool.m_cur+slot_size_bytes > pool.m_end)
+            _carve_slab(pool, size_class, has_dtor);
+        void* slot = pool.m_cur;
+        pool.m_cur += slot_size_bytes;
+        return slot;
+    }
+    void _carve_slab(Pool &pool, size_t size_class, bool has_dtor);
+    void* _alloc_large(size_t size_bytes, bool has_dtor);
+    void _free_arena(void* ptr, bool run_dtor);
+    void _reset_arena(size_t max_retained_bytes);
+    void* _take_page();
+    void* _alloc_block();
+    size_t _page_size() const { return m_parent ? m_parent->_page_size() : m_page_size_bytes; } // set by the root
+    void _free_block(void* page);
+    void _return_page(void* page);
+    void _unlink_dtor(DtorLink* link);
+    void _unlink_large(SlabHeader* header);
+    bool _is_before_mark(const MarkState &mark_state, const SlabHeader* header, const void* slot) const;
+    void _release_slot(SlabHeader* header, void* slot);
+    void _pop_mark();
+    void _rollback_top();
+    void _commit_top();
+    static size_t size_class_of(size_t size_bytes)
+    {
+        if(size_bytes <= 256)
+            return (size_bytes+15)/16-1; // 16-byte steps up to 256
+        return 15+(size_bytes-256+63)/64; // 64-byte steps up to MAX_POOLED_BYTES
+    }
+    static size_t size_of_class(size_t size_class)
+    {
+        if(size_class < 16)
+            return (size_class+1)*16;
+        return 256+(size_class-15)*64;
+    }
 };
 
 }
 
-// NOTE: doesn't work for arrays
-void* operator new(size_t size_bytes, xl::Allocator &alloc, std::string filename, size_t line_number,
-        xl::MemChunk::dtor_cb_t dtor_cb);
-void* operator new(size_t size_bytes, xl::Allocator &alloc, std::string filename, size_t line_number);
+// NOTE: doesn't work for arrays, use PNEW_ARRAY instead
+inline void* operator new(size_t size_bytes, xl::Allocator &alloc, const char* filename, size_t line_number,
+        xl::MemChunk::dtor_cb_t dtor_cb)
+{
+    return alloc._malloc(size_bytes, filename, line_number, dtor_cb);
+}
+inline void* operator new(size_t size_bytes, xl::Allocator &alloc, const char* filename, size_t line_number)
+{
+    return alloc._malloc(size_bytes, filename, line_number, NULL);
+}
+
+// called only when the constructor throws, e.g. BudgetExceeded from an allocation it makes,
+// so the dtor of the object that was never constructed must not run
+inline void operator delete(void* ptr, xl::Allocator &alloc, const char* filename, size_t line_number,
+        xl::MemChunk::dtor_cb_t dtor_cb)
+{
+    alloc._free(ptr, false);
+}
+inline void operator delete(void* ptr, xl::Allocator &alloc, const char* filename, size_t line_number)
+{
+    alloc._free(ptr, false);
+}
 
 #endif
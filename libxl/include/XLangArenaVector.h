@@ -0,0 +1,117 @@
+// XLang
+// -- A parser framework for language modeling
+// Copyright (C) 2011 onlyuser <mailto:onlyuser@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef XLANG_ARENA_VECTOR_H_
+#define XLANG_ARENA_VECTOR_H_
+
+#include "XLangAlloc.h" // Allocator
+#include "XLangType.h" // uint32_t
+#include <stddef.h> // size_t
+#include <string.h> // memmove, memcpy
+#include <algorithm> // std::max
+
+namespace xl {
+
+// Growable array of a trivially copyable type, stored next to its owner in an Allocator.
+// The first N elements are kept inline, past that they spill to the arena. Growth stays in
+// place while the buffer fits its size class.
+template<class T, size_t N = 0>
+class ArenaVector
+{
+public:
+    typedef T*       iterator;
+    typedef const T* const_iterator;
+
+    ArenaVector(Allocator &alloc)
+        : m_alloc(&alloc), m_data(N ? m_inline : NULL), m_size(0), m_capacity(N)
+    {}
+    ~ArenaVector()
+    {
+        if(m_data && !is_inline())
+            m_alloc->_free(m_data);
+    }
+    Allocator &allocator() const { return *m_alloc; }
+    bool is_inline() const { return N && m_data == m_inline; }
+    size_t size() const { return m_size; }
+    bool empty() const { return !m_size; }
+    T &operator[](size_t index) { return m_data[index]; }
+    const T &operator[](size_t index) const { return m_data[index]; }
+    iterator begin() { return m_data; }
+    iterator end() { return m_data+m_size; }
+    const_iterator begin() const { return m_data; }
+    const_iterator end() const { return m_data+m_size; }
+    void reserve(size_t n)
+    {
+        if(n <= m_capacity)
+            return;
+        if(is_inline())
+        {
+            m_data = reinterpret_cast<T*>(m_alloc->_malloc(sizeof(T)*n, PNEW_SITE));
+            memcpy(m_data, m_inline, sizeof(T)*m_size);
+        }
+        else
+            m_data = reinterpret_cast<T*>(m_alloc->_realloc(m_data, sizeof(T)*n, PNEW_SITE));
+        m_capacity = m_alloc->capacity(m_data)/sizeof(T);
+    }
+    void push_back(T value)
+    {
+        if(m_size == m_capacity)
+            reserve(m_capacity ? m_capacity*2 : 4);
+        m_data[m_size++] = value;
+    }
+    iterator insert(iterator pos, T value)
+    {
+        return insert(pos, &value, &value+1);
+    }
+    // the range must not come from this vector
+    iterator insert(iterator pos, const_iterator first, const_iterator last)
+    {
+        size_t index = pos-m_data;
+        size_t n = last-first;
+        if(m_size+n > m_capacity)
+            reserve(std::max<size_t>(m_size+n, m_capacity*2));
+        memmove(m_data+index+n, m_data+index, sizeof(T)*(m_size-index));
+        memcpy(m_data+index, first, sizeof(T)*n);
+        m_size += n;
+        return m_data+index;
+    }
+    iterator erase(iterator pos)
+    {
+        return erase(pos, pos+1);
+    }
+    iterator erase(iterator first, iterator last)
+    {
+        memmove(first, last, sizeof(T)*(end()-last));
+        m_size -= last-first;
+        return first;
+    }
+    void clear() { m_size = 0; }
+
+private:
+    Allocator* m_alloc; // in concurrent mode, each call goes to the calling thread's arena
+    T*         m_data;
+    uint32_t   m_size;
+    uint32_t   m_capacity;
+    T          m_inline[N ? N : 1];
+
+    ArenaVector(const ArenaVector &);
+    ArenaVector &operator=(const ArenaVector &);
+};
+
+}
+
+#endif
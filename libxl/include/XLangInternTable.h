@@ -0,0 +1,205 @@
+// XLang
+// -- A parser framework for language modeling
+// Copyright (C) 2011 onlyuser <mailto:onlyuser@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef XLANG_INTERN_TABLE_H_
+#define XLANG_INTERN_TABLE_H_
+
+#include "XLangAlloc.h" // Allocator
+#include <string> // std::string
+#include <vector> // std::vector
+#include <mutex> // std::mutex
+#include <atomic> // std::atomic
+#include <stdint.h> // uint32_t
+#include <string.h> // memcmp
+
+namespace xl {
+
+size_t hash_string(const char* s, size_t n); // FNV-1a
+inline size_t hash_combine(size_t hash, size_t value)
+{
+    return hash ^ (value+0x9e3779b9+(hash<<6)+(hash>>2));
+}
+
+// Open addressing with linear probing over strings that have data() and size(), keyed by
+// their bytes. Not synchronized.
+template<class T>
+class StringIndex
+{
+public:
+    StringIndex()
+        : m_count(0)
+    {}
+    size_t size() const { return m_count; }
+    const T* find(const char* s, size_t n, size_t hash) const
+    {
+        if(m_table.empty())
+            return NULL;
+        return m_table[_find_slot(s, n, hash)].m_value;
+    }
+    // must not be in the index yet
+    void insert(const T* value, size_t hash)
+    {
+        if((m_count+1)*4 > m_table.size()*3)
+            _grow();
+        entry_t &entry = m_table[_find_slot(value->data(), value->size(), hash)];
+        entry.m_hash  = hash;
+        entry.m_value = value;
+        m_count++;
+    }
+    // backward shift deletion, so later probes never stop at the hole
+    void erase(const T* value, size_t hash)
+    {
+        size_t mask = m_table.size()-1;
+        size_t index = _find_slot(value->data(), value->size(), hash);
+        size_t next = index;
+        for(;;)
+        {
+            next = (next+1) & mask;
+            const entry_t &entry = m_table[next];
+            if(!entry.m_value)
+                break;
+            size_t home = entry.m_hash & mask;
+            // move it back unless its home lies cyclically in (index, next]
+            if(index <= next ? (home <= index || home > next) : (home <= index && home > next))
+            {
+                m_table[index] = entry;
+                index = next;
+            }
+        }
+        m_table[index].m_value = NULL;
+        m_count--;
+    }
+
+private:
+    struct entry_t
+    {
+        size_t   m_hash;
+        const T* m_value; // NULL if empty
+    };
+
+    std::vector<entry_t> m_table; // size is a power of two, at most 3/4 full
+    size_t               m_count;
+
+    // the entry holding the string, or the empty entry where it would go
+    size_t _find_slot(const char* s, size_t n, size_t hash) const
+    {
+        size_t mask = m_table.size()-1;
+        size_t index = hash & mask;
+        for(;; index = (index+1) & mask)
+        {
+            const entry_t &entry = m_table[index];
+            if(!entry.m_value)
+                return index;
+            if(entry.m_hash == hash && entry.m_value->size() == n && !memcmp(entry.m_value->data(), s, n))
+                return index;
+        }
+    }
+    void _grow()
+    {
+        std::vector<entry_t> old_table;
+        old_table.swap(m_table);
+        entry_t empty_entry = {0, NULL};
+        m_table.resize(old_table.empty() ? 64 : old_table.size()*2, empty_entry);
+        size_t mask = m_table.size()-1;
+        for(auto p = old_table.begin(); p != old_table.end(); p++)
+        {
+            if(!(*p).m_value)
+                continue;
+            size_t index = (*p).m_hash & mask;
+            while(m_table[index].m_value)
+                index = (index+1) & mask;
+            m_table[index] = *p;
+        }
+    }
+};
+
+// Unique strings and their dense atom ids. Not synchronized.
+class InternTable
+{
+public:
+    InternTable(Allocator &alloc, uint32_t base_id = 0)
+        : m_alloc(alloc), m_base_id(base_id)
+    {}
+    uint32_t base_id() const { return m_base_id; } // atom id of the first string
+    size_t size() const { return m_string_vec.size(); }
+    const std::string* operator[](size_t index) const { return m_string_vec[index]; }
+    const std::string* find(const char* s, size_t n, size_t hash) const;
+    const std::string* insert(const char* s, size_t n, size_t hash);
+    void trim(size_t count);
+    static uint32_t atom_id(const std::string* unique_string);
+
+private:
+    friend class InternPool;
+
+    // a unique string and its atom id, the string must stay first
+    struct atom_t
+    {
+        std::string m_string;
+        uint32_t    m_id;
+
+        atom_t(const char* s, size_t n, uint32_t _id)
+            : m_string(s, n), m_id(_id)
+        {}
+    };
+
+    Allocator                      &m_alloc;
+    uint32_t                        m_base_id;
+    StringIndex<std::string>        m_index;
+    std::vector<const std::string*> m_string_vec; // in interning order
+};
+
+// Shared by the TreeContexts of many parses, and outlives them. Strings are only ever
+// added, so their atom ids stay valid for the life of the pool. Lookups never block,
+// inserts are serialized.
+class InternPool
+{
+public:
+    InternPool(std::string name = "intern pool");
+    ~InternPool();
+    size_t size() const { return m_size.load(std::memory_order_acquire); }
+    const std::string* find(const char* s, size_t n, size_t hash, size_t max_count) const;
+    const std::string* alloc_unique_string(const char* s, size_t n);
+    void dump(std::string indent) const { m_alloc.dump(indent); }
+
+private:
+    // the hash is written before the string is published, and never changes after
+    struct slot_t
+    {
+        size_t                           m_hash;
+        std::atomic<const std::string*>  m_string; // NULL if empty
+    };
+    // outgrown tables are kept until the pool goes, since readers may still be probing them
+    struct table_t
+    {
+        size_t  m_mask;
+        slot_t* m_slots;
+    };
+
+    Allocator              m_alloc;      // guarded by m_mutex
+    std::atomic<table_t*>  m_table;      // at most half full
+    std::atomic<size_t>    m_size;
+    std::vector<table_t*>  m_table_vec;  // every table, current last
+    std::mutex             m_mutex;      // taken by inserts only
+
+    const std::string* _find(const table_t* table, const char* s, size_t n, size_t hash) const;
+    table_t* _new_table(size_t slot_count);
+    void _grow();
+};
+
+}
+
+#endif
@@ -20,16 +20,56 @@
 
 #include <string> // std::string
 #include <vector> // std::vector
+#include <stddef.h> // size_t
+#include <string.h> // memcpy, memcmp
+#include <new> // placement new
 
 namespace xl {
 
+// Immutable and null-terminated, its bytes follow it in the same allocation, so it needs
+// no dtor. Made by TreeContext::alloc_string.
+class InlineString
+{
+public:
+    size_t size() const { return m_size; }
+    bool empty() const { return !m_size; }
+    const char* data() const { return reinterpret_cast<const char*>(this+1); }
+    const char* c_str() const { return data(); }
+    std::string str() const { return std::string(data(), m_size); }
+    operator std::string() const { return str(); }
+    bool operator==(const InlineString &other) const
+    {
+        return m_size == other.m_size && !memcmp(data(), other.data(), m_size);
+    }
+    bool operator!=(const InlineString &other) const { return !(*this == other); }
+
+    static size_t alloc_size(size_t n) { return sizeof(InlineString)+n+1; }
+    static InlineString* create(void* buf, const char* s, size_t n)
+    {
+        InlineString* inline_string = new (buf) InlineString(n);
+        char* bytes = reinterpret_cast<char*>(inline_string+1);
+        memcpy(bytes, s, n);
+        bytes[n] = '\0';
+        return inline_string;
+    }
+
+private:
+    InlineString(size_t _size)
+        : m_size(_size)
+    {}
+    InlineString(const InlineString &);
+    InlineString &operator=(const InlineString &);
+
+    size_t m_size;
+};
+
 bool                     read_file(std::string filename, std::string &s);
 std::string              replace(std::string &s, std::string find_string, std::string replace_string);
 std::vector<std::string> tokenize(const std::string &s, const char* delim = " ");
-std::string              escape_xml(std::string &s);
-std::string              unescape_xml(std::string &s);
-std::string              escape(std::string &s);
-std::string              unescape(std::string &s);
+std::string              escape_xml(const std::string &s);
+std::string              unescape_xml(const std::string &s);
+std::string              escape(const std::string &s);
+std::string              unescape(const std::string &s);
 std::string              escape(char c);
 char                     unescape(char c);
 
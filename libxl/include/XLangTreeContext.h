@@ -19,8 +19,13 @@
 #define XLANG_TREE_CONTEXT_H_
 
 #include "XLangAlloc.h" // Allocator
+#include "XLangInternTable.h" // InternTable, InternPool
+#include "XLangString.h" // InlineString
 #include <string> // std::string
-#include <set> // std::set
+#include <vector> // std::vector
+#include <unordered_map> // std::unordered_multimap
+#include <utility> // std::pair
+#include <mutex> // std::mutex
 
 namespace xl { namespace node { class NodeIdentIFace; } }
 
@@ -29,27 +34,77 @@ namespace xl {
 class TreeContext
 {
 public:
-    TreeContext(Allocator &alloc)
-        : m_alloc(alloc), m_root(NULL)
+    struct mark_t
+    {
+        Allocator::mark_t     m_alloc_mark;
+        size_t                m_arena_count;
+        size_t                m_string_count;
+        size_t                m_literal_count;
+        size_t                m_node_count;
+        node::NodeIdentIFace* m_root;
+    };
+
+    // With a pool, strings already in it are shared instead of interned again.
+    TreeContext(Allocator &alloc, InternPool* pool = NULL)
+        : m_alloc(alloc), m_root(NULL), m_pool(pool), m_intern_table(alloc, pool ? pool->size() : 0),
+          m_dedup_strings(false), m_hash_cons(false), m_lazy_clone(false)
     {}
-    Allocator &alloc() { return m_alloc; }
+    Allocator &alloc() { return m_arena_stack.empty() ? m_alloc : *m_arena_stack.back(); }
     node::NodeIdentIFace* &root() { return m_root; }
-    const std::string* alloc_unique_string(std::string name);
-    std::string* alloc_string(std::string s);
+    const std::string* alloc_unique_string(const char* s, size_t n);
+    const std::string* alloc_unique_string(const char* s);
+    const std::string* alloc_unique_string(const std::string &s) { return alloc_unique_string(s.data(), s.size()); }
+    static uint32_t atom_id(const std::string* unique_string) { return InternTable::atom_id(unique_string); }
+    size_t atom_count() const { return m_intern_table.base_id()+m_intern_table.size(); }
+    InternPool* pool() const { return m_pool; }
+    void publish_strings();
+    const InlineString* alloc_string(const char* s, size_t n);
+    const InlineString* alloc_string(const std::string &s) { return alloc_string(s.data(), s.size()); }
+    void set_dedup_strings(bool dedup_strings) { m_dedup_strings = dedup_strings; }
+    bool dedup_strings() const { return m_dedup_strings; }
+    void set_hash_cons(bool hash_cons) { m_hash_cons = hash_cons; } // see MVCModel
+    bool hash_cons() const { return m_hash_cons; }
+    void set_lazy_clone(bool lazy_clone) { m_lazy_clone = lazy_clone; } // see SymbolNode::clone
+    bool lazy_clone() const { return m_lazy_clone; }
+    template<class Equal>
+    node::NodeIdentIFace* find_node(size_t hash, Equal equal) const
+    {
+        auto range = m_node_index.equal_range(hash);
+        for(auto p = range.first; p != range.second; ++p)
+        {
+            if(equal(p->second))
+                return p->second;
+        }
+        return NULL;
+    }
+    void insert_node(size_t hash, node::NodeIdentIFace* _node);
+    mark_t mark();
+    void rollback(mark_t _mark);
+    void commit(mark_t _mark);
+    void push_arena();
+    void pop_arena(bool keep = false);
 
 private:
     Allocator &m_alloc;
     node::NodeIdentIFace* m_root; // parse result (parse tree root)
+    std::vector<Allocator*> m_arena_stack; // child arenas, innermost last
+    std::vector<size_t>     m_arena_node_count; // m_node_vec size at each push_arena
 
-    struct str_ptr_compare_t
-    {
-        bool operator()(const std::string* s1, const std::string* s2) const
-        {
-            return *s1 < *s2;
-        }
-    };
-    typedef std::set<std::string*, str_ptr_compare_t> string_set_t;
-    string_set_t m_string_set;
+    InternPool* m_pool;
+    InternTable m_intern_table; // strings not found in the pool, atom ids follow the pool's
+    bool        m_dedup_strings;
+    StringIndex<InlineString>        m_literal_index;
+    std::vector<const InlineString*> m_literal_vec; // in allocation order, for rollback
+    std::mutex m_string_mutex; // taken when the allocator is concurrent
+
+    // hash-consed nodes, not synchronized
+    bool m_hash_cons;
+    std::unordered_multimap<size_t, node::NodeIdentIFace*> m_node_index;
+    std::vector<std::pair<size_t, node::NodeIdentIFace*>>  m_node_vec; // in creation order, for rollback
+
+    void _trim_nodes(size_t count);
+
+    bool m_lazy_clone;
 };
 
 }
@@ -22,25 +22,57 @@
 #include "node/XLangNodeIFace.h" // node::NodeIdentIFace
 #include "node/XLangNode.h" // node::TermNode
 #include "XLangTreeContext.h" // TreeContext
+#include "XLangString.h" // InlineString
 #include "XLangType.h" // uint32_t
 #include <string> // std::string
+#include <vector> // std::vector
 
 namespace xl { namespace mvc {
 
+// With TreeContext::hash_cons(), make_term and make_symbol return the node made before in the
+// same context for an equal (type, lexer_id, value) or (lexer_id, children), so repeated
+// subtrees are shared and equal subtrees compare() by pointer. The result is a DAG that must
+// not be mutated, a shared node keeps its first parent and is_shared() is set.
 struct MVCModel
 {
     template<class T>
     static node::NodeIdentIFace* make_term(TreeContext* tc, uint32_t lexer_id, T value)
     {
-        return new (PNEW_LOC(tc->alloc())) node::TermNode<
-                static_cast<node::NodeIdentIFace::type_t>(node::TermType<T>::type)
-                >(lexer_id, value); // assumes trivial dtor
+        if(tc->hash_cons())
+            return make_shared_term(tc, lexer_id, value);
+        return new_term(tc, lexer_id, value);
     }
     static node::SymbolNode* make_symbol(TreeContext* tc, uint32_t lexer_id, size_t size, ...);
     static node::SymbolNode* make_symbol(TreeContext* tc, uint32_t lexer_id, std::vector<node::NodeIdentIFace*>& vec);
     static node::NodeIdentIFace* make_ast(TreeContext* tc, std::string filename);
+    static node::NodeIdentIFace* extract(TreeContext* tc, const node::NodeIdentIFace* _node);
+
+private:
+    template<class T>
+    static node::NodeIdentIFace* new_term(TreeContext* tc, uint32_t lexer_id, T value)
+    {
+        return new (PNEW_LOC(tc->alloc())) node::TermNode<
+                static_cast<node::NodeIdentIFace::type_t>(node::TermType<T>::type)
+                >(lexer_id, value); // assumes trivial dtor
+    }
+    static node::NodeIdentIFace* make_shared_term(TreeContext* tc, uint32_t lexer_id, long value);
+    static node::NodeIdentIFace* make_shared_term(TreeContext* tc, uint32_t lexer_id, float32_t value);
+    static node::NodeIdentIFace* make_shared_term(TreeContext* tc, uint32_t lexer_id, const InlineString* value);
+    static node::NodeIdentIFace* make_shared_term(TreeContext* tc, uint32_t lexer_id, char value);
+    static node::NodeIdentIFace* make_shared_term(TreeContext* tc, uint32_t lexer_id, const std::string* value);
+    template<class T>
+    static node::NodeIdentIFace* _make_shared_term(TreeContext* tc, uint32_t lexer_id, T value);
 };
 
+template<>
+node::NodeIdentIFace* MVCModel::new_term<
+        node::TermInternalType<node::NodeIdentIFace::STRING>::type
+        >(TreeContext* tc, uint32_t lexer_id, node::TermInternalType<node::NodeIdentIFace::STRING>::type value);
+template<>
+node::NodeIdentIFace* MVCModel::new_term<
+        node::TermInternalType<node::NodeIdentIFace::IDENT>::type
+        >(TreeContext* tc, uint32_t lexer_id, node::TermInternalType<node::NodeIdentIFace::IDENT>::type value);
+
 } }
 
 #endif
@@ -0,0 +1,183 @@
+// XLang
+// -- A parser framework for language modeling
+// Copyright (C) 2011 onlyuser <mailto:onlyuser@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef XLANG_FLAT_TREE_H_
+#define XLANG_FLAT_TREE_H_
+
+#include "node/XLangNodeIFace.h" // node::NodeIdentIFace
+#include "XLangString.h" // InlineString
+#include "XLangType.h" // float32_t
+#include <string> // std::string
+#include <vector> // std::vector
+#include <stdint.h> // uint32_t
+
+namespace xl { namespace node {
+
+// Read-only snapshot of a tree as parallel arrays in preorder, so a pass over it is a linear
+// scan. The first child of a symbol follows it, its next sibling is index+subtree_size(index).
+// Terms refer to the source tree's strings, which must outlive the snapshot.
+class FlatTree
+{
+public:
+    static const uint8_t NIL = 0xFF; // type of a NULL child
+
+    FlatTree(const NodeIdentIFace* root);
+    size_t size() const { return m_type_vec.size(); }
+    uint8_t type(size_t index) const { return m_type_vec[index]; }
+    uint32_t lexer_id(size_t index) const { return m_lexer_id_vec[index]; }
+    int parent(size_t index) const { return m_parent_vec[index]; } // -1 for the root
+    size_t subtree_size(size_t index) const { return m_subtree_size_vec[index]; }
+    size_t child_count(size_t index) const
+    {
+        return m_type_vec[index] == NodeIdentIFace::SYMBOL ? m_value_vec[index].m_children.m_count : 0;
+    }
+    size_t child(size_t index, size_t n) const
+    {
+        return m_child_vec[m_value_vec[index].m_children.m_offset+n];
+    }
+    template<NodeIdentIFace::type_t T>
+    typename TermInternalType<T>::type value(size_t index) const;
+
+private:
+    union value_t
+    {
+        long                m_int;
+        float32_t           m_float;
+        const InlineString* m_string;
+        char                m_char;
+        const std::string*  m_ident;
+        struct
+        {
+            uint32_t m_offset; // into m_child_vec
+            uint32_t m_count;
+        } m_children;
+    };
+
+    std::vector<uint8_t>  m_type_vec;
+    std::vector<uint32_t> m_lexer_id_vec;
+    std::vector<int32_t>  m_parent_vec;
+    std::vector<uint32_t> m_subtree_size_vec;
+    std::vector<value_t>  m_value_vec;
+    std::vector<uint32_t> m_child_vec; // children of each symbol, contiguous
+};
+
+template<> inline long FlatTree::value<NodeIdentIFace::INT>(size_t index) const
+{
+    return m_value_vec[index].m_int;
+}
+template<> inline float32_t FlatTree::value<NodeIdentIFace::FLOAT>(size_t index) const
+{
+    return m_value_vec[index].m_float;
+}
+template<> inline const InlineString* FlatTree::value<NodeIdentIFace::STRING>(size_t index) const
+{
+    return m_value_vec[index].m_string;
+}
+template<> inline char FlatTree::value<NodeIdentIFace::CHAR>(size_t index) const
+{
+    return m_value_vec[index].m_char;
+}
+template<> inline const std::string* FlatTree::value<NodeIdentIFace::IDENT>(size_t index) const
+{
+    return m_value_vec[index].m_ident;
+}
+
+class FlatNode;
+
+template<NodeIdentIFace::type_t T>
+class FlatTermNode : virtual public TermNodeIFace<T>
+{
+public:
+    typename TermInternalType<T>::type value() const;
+};
+
+// One entry of a FlatTree seen through the node interfaces, so visitors written against
+// NodeIdentIFace run on the snapshot unchanged. Read-only: set_parent() is ignored.
+class FlatNode
+    : public SymbolNodeIFace,
+      public FlatTermNode<NodeIdentIFace::INT>,
+      public FlatTermNode<NodeIdentIFace::FLOAT>,
+      public FlatTermNode<NodeIdentIFace::STRING>,
+      public FlatTermNode<NodeIdentIFace::CHAR>,
+      public FlatTermNode<NodeIdentIFace::IDENT>
+{
+public:
+    FlatNode(const FlatNode* nodes, const FlatTree* tree, size_t index)
+        : m_nodes(nodes), m_tree(tree), m_index(index)
+    {}
+
+    // required
+    type_t type() const
+    {
+        return static_cast<type_t>(m_tree->type(m_index));
+    }
+    uint32_t lexer_id() const
+    {
+        return m_tree->lexer_id(m_index);
+    }
+    std::string name() const;
+    void set_parent(NodeIdentIFace* parent)
+    {}
+    NodeIdentIFace* parent() const;
+    std::string uid() const;
+    NodeIdentIFace* operator[](uint32_t index) const;
+    size_t size() const
+    {
+        return m_tree->child_count(m_index);
+    }
+
+    // optional
+    const void* typed_iface() const;
+    int index() const;
+    size_t hash() const;
+
+    const FlatTree* tree() const { return m_tree; }
+    size_t flat_index() const { return m_index; }
+
+private:
+    const FlatNode* m_nodes; // all nodes of the view, by flat index
+    const FlatTree* m_tree;
+    size_t          m_index;
+};
+
+template<NodeIdentIFace::type_t T>
+typename TermInternalType<T>::type FlatTermNode<T>::value() const
+{
+    const FlatNode* self = static_cast<const FlatNode*>(this);
+    return self->tree()->template value<T>(self->flat_index());
+}
+
+// Visitor adapter: a FlatNode per entry, e.g. MVCView::print_lisp(FlatTreeView(flat).root()).
+// NULL children come back as NULL.
+class FlatTreeView
+{
+public:
+    FlatTreeView(const FlatTree &tree);
+    const NodeIdentIFace* root() const { return node(0); }
+    const NodeIdentIFace* node(size_t index) const;
+
+private:
+    std::vector<FlatNode> m_node_vec; // each entry points into m_node_vec, so a view can't be copied
+
+    FlatTreeView(const FlatTreeView &);
+    FlatTreeView &operator=(const FlatTreeView &);
+};
+
+} }
+
+#endif
@@ -20,6 +20,7 @@
 
 #include "node/XLangNodeIFace.h" // node::NodeIdentIFace
 #include "XLangTreeContext.h" // TreeContext
+#include "XLangArenaVector.h" // ArenaVector
 #include "XLangType.h" // uint32_t
 #include <string> // std::string
 #include <vector> // std::vector
@@ -32,7 +33,7 @@ class Node : virtual public NodeIdentIFace
 public:
     Node(NodeIdentIFace::type_t _type, uint32_t _lexer_id)
         : m_type(_type), m_lexer_id(_lexer_id), m_parent(NULL), m_original(NULL),
-          m_depth(-1), m_height(-1), m_bfs_index(-1)
+          m_depth(-1), m_height(-1), m_bfs_index(-1), m_slot(-1), m_shared(false), m_hash(0)
     {}
 
     // required
@@ -66,6 +67,23 @@ public:
     {
         return m_original ? m_original : this;
     }
+    void set_slot(int slot)
+    {
+        m_slot = slot;
+    }
+    int slot() const
+    {
+        return m_slot;
+    }
+    void set_shared(bool shared)
+    {
+        m_shared = shared;
+    }
+    bool is_shared() const
+    {
+        return m_shared;
+    }
+    void invalidate_hash();
 
     // visitation-related
     void set_depth(int depth)
@@ -101,6 +119,9 @@ protected:
     int                    m_depth;
     int                    m_height;
     int                    m_bfs_index;
+    int                    m_slot;
+    bool                   m_shared;
+    mutable size_t         m_hash; // 0 until computed, then kept until invalidate_hash()
 };
 
 template<NodeIdentIFace::type_t _type>
@@ -114,6 +135,16 @@ public:
     {
         return m_value;
     }
+    const void* typed_iface() const
+    {
+        return static_cast<const TermNodeIFace<_type>*>(this);
+    }
+    size_t hash() const
+    {
+        if(!m_hash)
+            m_hash = TermNodeIFace<_type>::hash();
+        return m_hash;
+    }
     NodeIdentIFace* clone(TreeContext* tc) const
     {
         return new (PNEW_LOC(tc->alloc()))
@@ -121,49 +152,90 @@ public:
     }
     bool compare(const NodeIdentIFace* _node) const
     {
+        if(_node == this)
+            return true;
         if(!is_same_type(_node))
             return false;
-        return m_value == dynamic_cast<const TermNode<_type>*>(_node)->value();
+        return m_value == node_cast<TermNodeIFace<_type>>(_node)->value();
     }
 
 private:
     typename TermInternalType<_type>::type m_value;
 };
 
+// STRING terms compare by content, defined in XLangNode.cpp
+template<>
+NodeIdentIFace* TermNode<NodeIdentIFace::STRING>::clone(TreeContext* tc) const;
+template<>
+bool TermNode<NodeIdentIFace::STRING>::compare(const NodeIdentIFace* _node) const;
+
 class SymbolNode : public Node, public SymbolNodeIFace
 {
 public:
-    SymbolNode(uint32_t _lexer_id, size_t _size, va_list ap);
-    SymbolNode(uint32_t _lexer_id, std::vector<NodeIdentIFace*>& vec);
+    SymbolNode(TreeContext* tc, uint32_t _lexer_id, size_t _size, va_list ap);
+    SymbolNode(TreeContext* tc, uint32_t _lexer_id, std::vector<NodeIdentIFace*>& vec);
+    ~SymbolNode();
 
     // required
     NodeIdentIFace* operator[](uint32_t index) const
     {
-        return m_child_vec[index];
+        if(m_lazy_tc)
+            return (*_source())[index];
+        _sync_ranked();
+        return m_child_vec[_slot_of(index)];
     }
     size_t size() const
     {
-        return m_child_vec.size();
+        if(m_lazy_tc)
+            return _source()->size();
+        return m_child_vec.size()-m_hole_count;
     }
 
     // optional
     NodeIdentIFace* clone(TreeContext* tc) const;
+    const void* typed_iface() const
+    {
+        return static_cast<const SymbolNodeIFace*>(this);
+    }
     bool compare(const NodeIdentIFace* _node) const
     {
+        if(_node == this)
+            return true;
+        if(m_lazy_tc)
+            return m_original->compare(_node);
         if(!is_same_type(_node))
             return false;
-        auto symbol_node = dynamic_cast<const SymbolNode*>(_node);
+        if(hash() != _node->hash())
+            return false;
+        auto symbol_node = node_cast<SymbolNodeIFace>(_node);
+        _sync();
         if(m_child_vec.size() != symbol_node->size())
             return false;
         for(size_t i = 0; i<m_child_vec.size(); i++)
         {
-            if(!m_child_vec[i]->compare(const_cast<const NodeIdentIFace*>((*symbol_node)[i])))
+            const NodeIdentIFace* other_child = (*symbol_node)[i];
+            if(!m_child_vec[i] || !other_child)
+            {
+                if(m_child_vec[i] != other_child)
+                    return false;
+                continue;
+            }
+            if(!m_child_vec[i]->compare(other_child))
                 return false;
         }
         return true;
     }
+    size_t hash() const
+    {
+        if(!m_hash)
+            m_hash = m_lazy_tc ? m_original->hash() : SymbolNodeIFace::hash();
+        return m_hash;
+    }
     NodeIdentIFace* find(const NodeIdentIFace* _node) const
     {
+        if(m_lazy_tc)
+            return _source()->find(_node);
+        _sync();
         for(auto p = m_child_vec.begin(); p != m_child_vec.end(); p++)
         {
             if((*p)->compare(_node))
@@ -177,9 +249,16 @@ public:
     void remove_first(NodeIdentIFace* _node);
     void replace_first(NodeIdentIFace* find_node, NodeIdentIFace* replace_node);
     void erase(int index);
+    NodeIdentIFace* edit(uint32_t index);
     NodeIdentIFace* find_if(bool (*pred)(const NodeIdentIFace* _node)) const;
+    int index_of(const NodeIdentIFace* _node) const;
 
     // built-in
+    void reserve(size_t size)
+    {
+        _unshare();
+        m_child_vec.reserve(size);
+    }
     static NodeIdentIFace* eol()
     {
         static int dummy;
@@ -187,7 +266,67 @@ public:
     }
 
 private:
-    std::vector<NodeIdentIFace*> m_child_vec;
+    // Removed children leave holes, so a run of detaches takes constant time each. Reads by
+    // position see through them with a Fenwick tree of the holes, built on first use. They are
+    // squeezed out once they are half the list, or by calls that scan or shift the list anyway.
+    // Const calls may squeeze too.
+    mutable ArenaVector<NodeIdentIFace*, 2> m_child_vec; // inline for unary and binary nodes, else in the same arena
+    mutable uint32_t m_hole_count;
+    mutable uint32_t m_first_hole;
+    mutable uint32_t m_hole_tree_size; // slots m_hole_tree covers, 0 if it must be rebuilt
+    mutable uint32_t* m_hole_tree;     // 1-based, holes per slot range
+    TreeContext* m_lazy_tc; // set while a lazy clone has not copied original()'s children yet
+
+    static NodeIdentIFace* hole()
+    {
+        static int dummy;
+        return reinterpret_cast<NodeIdentIFace*>(&dummy);
+    }
+    // short lists are squeezed on every read, it costs no more than ranking through the holes
+    static const size_t MIN_RANKED_SIZE = 32;
+
+    // what a lazy clone reads through to
+    const SymbolNodeIFace* _source() const
+    {
+        return node_cast<SymbolNodeIFace>(m_original);
+    }
+    // squeezes out the holes, a lazy clone has none
+    void _sync() const
+    {
+        if(m_hole_count)
+            _remove_holes();
+    }
+    // same, but leaves holes that _slot_of and _index_of_slot can rank through
+    void _sync_ranked() const
+    {
+        if(m_hole_count && (m_child_vec.size() < MIN_RANKED_SIZE || m_hole_count*2 >= m_child_vec.size()))
+            _remove_holes();
+    }
+    size_t _slot_of(size_t index) const
+    {
+        return (!m_hole_count || index < m_first_hole) ? index : _select_slot(index);
+    }
+    size_t _index_of_slot(size_t slot) const
+    {
+        return (!m_hole_count || slot < m_first_hole) ? slot : slot-_holes_before(slot);
+    }
+    // gives a lazy clone its own children, then syncs, before m_child_vec is changed
+    void _unshare()
+    {
+        if(m_lazy_tc)
+            _materialize();
+        _sync();
+    }
+    void _materialize();
+    NodeIdentIFace* _materialize(NodeIdentIFace* _node);
+    void _remove_holes() const;
+    void _build_hole_tree() const;
+    size_t _select_slot(size_t index) const;
+    size_t _holes_before(size_t slot) const;
+    void _grow_hole_tree() const;
+    void _renumber(size_t from) const;
+    void _adopt(NodeIdentIFace* child, bool hash_cons = false);
+    void _make_hole(size_t slot);
 };
 
 } }
@@ -19,10 +19,11 @@
 #define XLANG_NODE_IFACE_H_
 
 #include "XLangType.h" // uint32_t
+#include "XLangTreeContext.h" // TreeContext
+#include "XLangString.h" // InlineString
+#include "XLangInternTable.h" // hash_string, hash_combine
 #include <string> // std::string
 
-namespace xl { class TreeContext; }
-
 namespace xl { namespace node {
 
 struct NodeIdentIFace
@@ -61,6 +62,28 @@ struct NodeIdentIFace
     {
         return NULL;
     }
+    virtual const void* typed_iface() const // the TermNodeIFace or SymbolNodeIFace matching type()
+    {
+        return NULL;
+    }
+    virtual void set_slot(int slot) // position in the parent's child list, kept by the parent
+    {}
+    virtual int slot() const
+    {
+        return -1;
+    }
+    virtual void set_shared(bool shared) // hash-consed and adopted by several parents, parent() is the first
+    {}
+    virtual bool is_shared() const
+    {
+        return false;
+    }
+    virtual size_t hash() const // structural, equal subtrees have equal hashes, never 0
+    {
+        return 1;
+    }
+    virtual void invalidate_hash() // after a change below this node
+    {}
 
     // visitation-related
     virtual void set_depth(int depth)
@@ -97,7 +120,7 @@ template<NodeIdentIFace::type_t>
 struct TermInternalType;
 template<> struct TermInternalType<NodeIdentIFace::INT>    { typedef long type; };
 template<> struct TermInternalType<NodeIdentIFace::FLOAT>  { typedef float32_t type; };
-template<> struct TermInternalType<NodeIdentIFace::STRING> { typedef std::string* type; };
+template<> struct TermInternalType<NodeIdentIFace::STRING> { typedef const InlineString* type; };
 template<> struct TermInternalType<NodeIdentIFace::CHAR>   { typedef char type; };
 template<> struct TermInternalType<NodeIdentIFace::IDENT>  { typedef const std::string* type; };
 template<> struct TermInternalType<NodeIdentIFace::SYMBOL> { typedef NodeIdentIFace* type; };
@@ -106,17 +129,36 @@ template<class T>
 struct TermType;
 template<> struct TermType<long>               { enum { type = NodeIdentIFace::INT}; };
 template<> struct TermType<float32_t>          { enum { type = NodeIdentIFace::FLOAT}; };
-template<> struct TermType<std::string*>       { enum { type = NodeIdentIFace::STRING}; };
+template<> struct TermType<const InlineString*> { enum { type = NodeIdentIFace::STRING}; };
 template<> struct TermType<char>               { enum { type = NodeIdentIFace::CHAR}; };
 template<> struct TermType<const std::string*> { enum { type = NodeIdentIFace::IDENT}; };
 template<> struct TermType<NodeIdentIFace*>    { enum { type = NodeIdentIFace::SYMBOL}; };
 
+inline size_t hash_value(long value)                { return static_cast<size_t>(value); }
+inline size_t hash_value(float32_t value)           { return value == 0 ? 0 : hash_string(reinterpret_cast<const char*>(&value), sizeof(value)); } // -0.0 == 0.0
+inline size_t hash_value(const InlineString* value) { return hash_string(value->data(), value->size()); }
+inline size_t hash_value(char value)                { return static_cast<unsigned char>(value); }
+inline size_t hash_value(const std::string* value)  { return hash_string(value->data(), value->size()); }
+
 template<NodeIdentIFace::type_t T>
 struct TermNodeIFace : virtual public NodeIdentIFace
 {
     virtual ~TermNodeIFace()
     {}
     virtual typename TermInternalType<T>::type value() const = 0;
+
+    // optional
+    size_t hash() const
+    {
+        size_t hash = hash_combine(hash_combine(hash_value(value()), T), lexer_id());
+        return hash ? hash : 1;
+    }
+
+    // built-in (part of interface), IDENT only
+    uint32_t atom_id() const
+    {
+        return TreeContext::atom_id(value());
+    }
 };
 
 struct SymbolNodeIFace : virtual public NodeIdentIFace
@@ -145,11 +187,70 @@ struct SymbolNodeIFace : virtual public NodeIdentIFace
     {}
     virtual void erase(int index)
     {}
+    virtual NodeIdentIFace* edit(uint32_t index) // operator[], but safe to change, see SymbolNode::clone
+    {
+        return (*this)[index];
+    }
     virtual NodeIdentIFace* find_if(bool (*pred)(const NodeIdentIFace* _node)) const
     {
         return NULL;
     }
+    virtual int index_of(const NodeIdentIFace* _node) const
+    {
+        for(size_t i = 0; i<size(); i++)
+        {
+            if((*this)[i] == _node)
+                return i;
+        }
+        return -1;
+    }
+    size_t hash() const // Merkle hash over the children's
+    {
+        size_t hash = hash_combine(SYMBOL, lexer_id());
+        for(size_t i = 0; i<size(); i++)
+        {
+            const NodeIdentIFace* child = (*this)[i];
+            hash = hash_combine(hash, child ? child->hash() : 0);
+        }
+        return hash ? hash : 1;
+    }
+};
+
+// the type() a node implementing T has, or -1 if T is no typed interface
+template<class T>
+struct TypedIFaceType
+{
+    static const int value = -1;
 };
+template<NodeIdentIFace::type_t _type>
+struct TypedIFaceType<TermNodeIFace<_type>>
+{
+    static const int value = _type;
+};
+template<>
+struct TypedIFaceType<SymbolNodeIFace>
+{
+    static const int value = NodeIdentIFace::SYMBOL;
+};
+
+// Downcasts a node without a dynamic_cast through the virtual base when T is the interface
+// typed_iface() returns for the node's type(). Anything else goes through dynamic_cast.
+template<class T>
+const T* node_cast(const NodeIdentIFace* _node)
+{
+    if(TypedIFaceType<T>::value == static_cast<int>(_node->type()))
+    {
+        const void* typed_iface = _node->typed_iface();
+        if(typed_iface)
+            return static_cast<const T*>(typed_iface);
+    }
+    return dynamic_cast<const T*>(_node);
+}
+template<class T>
+T* node_cast(NodeIdentIFace* _node)
+{
+    return const_cast<T*>(node_cast<T>(static_cast<const NodeIdentIFace*>(_node)));
+}
 
 } }
 
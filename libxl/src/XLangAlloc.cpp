@@ -20,87 +20,892 @@
 #include <iostream> // std::cout
 #include <stdlib.h> // malloc
 #include <stddef.h> // size_t
+#include <new> // std::bad_alloc
+#include <string.h> // memset, memcpy
+#include <stdint.h> // uintptr_t
+#include <map> // std::map
+#include <vector> // std::vector
+#include <algorithm> // std::stable_sort, std::sort
+#include <mutex> // std::mutex, std::lock_guard
+#include <thread> // std::this_thread
+#include <atomic> // std::atomic
+#include <sys/mman.h> // mmap, munmap, madvise
 
 namespace xl {
 
-MemChunk::MemChunk(size_t _size_bytes, std::string _filename, size_t _line_number, dtor_cb_t dtor_cb)
-    : m_size_bytes(_size_bytes), m_filename(_filename), m_line_number(_line_number), m_dtor_cb(dtor_cb)
+static std::atomic<size_t> next_allocator_id(1);
+
+const size_t Allocator::PAGE_SIZE_BYTES;
+const size_t Allocator::HUGE_PAGE_SIZE_BYTES;
+const size_t Allocator::SLAB_SIZE_BYTES;
+const size_t Allocator::ALIGN_BYTES;
+const size_t Allocator::MAX_POOLED_BYTES;
+const size_t Allocator::SIZE_CLASS_COUNT;
+const size_t Allocator::SLAB_HEADER_BYTES;
+const size_t Allocator::DTOR_LINK_BYTES;
+
+void AllocSite::dump(std::string indent) const
+{
+    std::cout << indent << m_filename << ":" << m_line_number << (m_dtor_cb ? " (dtor)" : "")
+            << " .. " << m_live_bytes << " bytes in " << m_live_count << " live chunks"
+            << ", peak " << m_peak_bytes << " bytes"
+            << ", " << m_alloc_bytes << " bytes in " << m_alloc_count << " allocs";
+}
+
+MemChunk::MemChunk(size_t _size_bytes, AllocSite* _site, size_t _serial)
+    : m_size_bytes(_size_bytes), m_site(_site), m_serial(_serial)
 {
-    m_ptr = malloc(_size_bytes);
+    m_ptr = malloc(std::max(_size_bytes, sizeof(void*))); // room to link it into a remote free list
+    m_site->m_alloc_count++;
+    m_site->m_alloc_bytes += _size_bytes;
+    m_site->m_live_count++;
+    m_site->m_live_bytes += _size_bytes;
+    if(m_site->m_live_bytes > m_site->m_peak_bytes)
+        m_site->m_peak_bytes = m_site->m_live_bytes;
 }
 
 MemChunk::~MemChunk()
 {
     if(m_ptr)
     {
-        if(m_dtor_cb)
-            m_dtor_cb(m_ptr);
+        if(m_site->m_dtor_cb)
+            m_site->m_dtor_cb(m_ptr);
         free(m_ptr);
     }
+    m_site->m_live_count--;
+    m_site->m_live_bytes -= m_size_bytes;
 }
 
 void MemChunk::dump(std::string indent) const
 {
-    std::cout << indent << m_filename << ":" << m_line_number << " .. " << m_size_bytes << " bytes";
+    std::cout << indent << m_site->m_filename << ":" << m_site->m_line_number << " .. " << m_size_bytes << " bytes";
+}
+
+#ifdef XLANG_NO_ALLOC_TRACKING
+    #define TRACKING_OR_ARENA(mode) MODE_ARENA
+#else
+    #define TRACKING_OR_ARENA(mode) (mode)
+#endif
+
+Allocator::Allocator(std::string _name, mode_e _mode, bool _concurrent)
+    : m_name(_name), m_mode(TRACKING_OR_ARENA(_mode)), m_parent(NULL), m_root(this), m_concurrent(_concurrent), m_id(next_allocator_id++),
+      m_size_bytes(0), m_max_bytes(static_cast<size_t>(-1)), m_max_chunks(static_cast<size_t>(-1)),
+      m_block_source(BLOCK_MALLOC), m_page_size_bytes(PAGE_SIZE_BYTES), m_prefault(false), m_block_count(0),
+      m_page_index(0), m_slab_cur(NULL), m_slab_end(NULL), m_large_list(NULL), m_large_free_list(NULL),
+      m_dtor_list(NULL),
+      m_dtor_count(0), m_large_count(0), m_serial(0), m_chunk_serial(0), m_resetting(false),
+      m_shared_size_bytes(0), m_shared_chunk_count(0), m_charged_size_bytes(0), m_charged_chunk_count(0),
+      m_remote_free_list(NULL)
+{
+    memset(m_pool, 0, sizeof(m_pool));
 }
 
-Allocator::Allocator(std::string name)
-    : m_name(name), m_size_bytes(0)
+// A child arena must not outlive its parent. Allocating it in the parent with PNEW ties
+// its lifetime to the parent, and to the parent's marks.
+Allocator::Allocator(std::string _name, Allocator &_parent)
+    : m_name(_name), m_mode(_parent.m_mode), m_parent(&_parent), m_root(_parent.m_root), m_concurrent(false),
+      m_id(next_allocator_id++), m_size_bytes(0), m_max_bytes(static_cast<size_t>(-1)), m_max_chunks(static_cast<size_t>(-1)),
+      m_block_source(BLOCK_MALLOC), m_page_size_bytes(PAGE_SIZE_BYTES), m_prefault(false), m_block_count(0),
+      m_page_index(0), m_slab_cur(NULL), m_slab_end(NULL), m_large_list(NULL), m_large_free_list(NULL),
+      m_dtor_list(NULL),
+      m_dtor_count(0), m_large_count(0), m_serial(0), m_chunk_serial(0), m_resetting(false),
+      m_shared_size_bytes(0), m_shared_chunk_count(0), m_charged_size_bytes(0), m_charged_chunk_count(0),
+      m_remote_free_list(NULL)
 {
+    memset(m_pool, 0, sizeof(m_pool));
 }
+
 Allocator::~Allocator()
 {
     _free();
 }
 
-void* Allocator::_malloc(size_t size_bytes, std::string filename, size_t line_number,
+void* Allocator::_malloc_tracking(size_t size_bytes, const char* filename, size_t line_number,
         MemChunk::dtor_cb_t dtor_cb)
 {
-    MemChunk* chunk = new MemChunk(size_bytes, filename, line_number, dtor_cb);
+    MemChunk* chunk = new MemChunk(size_bytes, _intern_site(filename, line_number, dtor_cb), m_chunk_serial++);
     m_size_bytes += size_bytes;
     m_chunk_map.insert(internal_type_t::value_type(chunk->ptr(), chunk));
     return chunk->ptr();
 }
 
-void Allocator::_free(void* ptr)
+// Grows a chunk allocated without a dtor. It stays in place while it fits its size class.
+void* Allocator::_realloc(void* ptr, size_t size_bytes, const char* filename, size_t line_number)
 {
-    auto p = m_chunk_map.find(ptr);
-    if(p != m_chunk_map.end())
+    if(!ptr)
+        return _malloc(size_bytes, filename, line_number);
+    size_t capacity_bytes = capacity(ptr);
+    if(size_bytes <= capacity_bytes)
+        return ptr;
+    void* new_ptr = _malloc(size_bytes, filename, line_number);
+    memcpy(new_ptr, ptr, capacity_bytes);
+    _free(ptr);
+    return new_ptr;
+}
+
+// usable bytes of a chunk, at least what was asked for
+size_t Allocator::capacity(const void* ptr)
+{
+    if(m_concurrent && m_mode == MODE_TRACKING)
     {
-        MemChunk* chunk = (*p).second;
-        m_size_bytes -= chunk->size();
-        delete chunk;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto q = m_owner_map.find(const_cast<void*>(ptr));
+        return (q != m_owner_map.end()) ? (*q).second.m_size_bytes : 0;
+    }
+    if(m_mode == MODE_ARENA)
+    {
+        const SlabHeader* header = reinterpret_cast<const SlabHeader*>(
+                reinterpret_cast<uintptr_t>(ptr) & ~static_cast<uintptr_t>(SLAB_SIZE_BYTES-1));
+        return header->m_size_bytes-(header->m_has_dtor ? DTOR_LINK_BYTES : 0);
+    }
+    auto p = m_chunk_map.find(const_cast<void*>(ptr));
+    return (p != m_chunk_map.end()) ? (*p).second->size() : 0;
+}
+
+// Without run_dtor, the chunk's dtor is skipped, as for an object whose constructor threw.
+void Allocator::_free(void* ptr, bool run_dtor)
+{
+    if(m_concurrent)
+    {
+        _free_concurrent(ptr, run_dtor);
+        return;
+    }
+    if(m_mode == MODE_ARENA)
+        _free_arena(ptr, run_dtor);
+    else
+    {
+        auto p = m_chunk_map.find(ptr);
+        if(p != m_chunk_map.end())
+        {
+            MemChunk* chunk = (*p).second;
+            m_size_bytes -= chunk->size();
+            if(!run_dtor)
+                free(chunk->release());
+            delete chunk;
+            m_chunk_map.erase(p);
+        }
     }
-    m_chunk_map.erase(p);
+    if(m_root->_has_budget())
+        m_root->_charge(*this);
 }
 
 void Allocator::_free()
 {
-    for(auto p = m_chunk_map.begin(); p != m_chunk_map.end(); ++p)
-        delete (*p).second;
-    m_chunk_map.clear();
+    reset(0);
+}
+
+// Runs all registered dtors and makes every chunk available again, but keeps up to
+// max_retained_bytes of pages and large chunks around for the next parse.
+void Allocator::reset(size_t max_retained_bytes)
+{
+    _drain_remote_frees();
+    while(!m_mark_stack.empty())
+    {
+        _unlink_dtor(&m_mark_stack.back().m_dtor_sentinel);
+        _unlink_large(&m_mark_stack.back().m_large_sentinel);
+        m_mark_stack.pop_back();
+    }
+    if(m_concurrent)
+    {
+        // runs the dtors of every thread's chunks and takes back their pages
+        local_map_t local_map;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            local_map.swap(m_local_map);
+            m_owner_map.clear();
+            m_id = next_allocator_id++;
+        }
+        m_resetting = true;
+        for(auto q = local_map.begin(); q != local_map.end(); ++q)
+            delete (*q).second;
+        m_resetting = false;
+        m_shared_size_bytes  = 0;
+        m_shared_chunk_count = 0;
+    }
+    while(!m_chunk_map.empty())
+    {
+        // unmapped first, since a dtor may free other chunks
+        MemChunk* chunk = (*m_chunk_map.begin()).second;
+        m_chunk_map.erase(m_chunk_map.begin());
+        delete chunk;
+    }
+    _reset_arena(max_retained_bytes);
+    m_size_bytes = 0;
+    m_serial = 0;
+    m_chunk_serial = 0;
+    if(m_root->_has_budget())
+        m_root->_charge(*this);
+}
+
+// Bounds the live bytes, and the number of allocations since the last reset. The budget is
+// kept by the root allocator, and covers the child arenas made from it and, in concurrent
+// mode, every thread's arena.
+void Allocator::set_budget(size_t max_bytes, size_t max_chunks)
+{
+    if(m_root != this)
+    {
+        m_root->set_budget(max_bytes, max_chunks);
+        return;
+    }
+    m_max_bytes  = max_bytes;
+    m_max_chunks = max_chunks;
+    // child arenas not charged yet add all their usage the next time they allocate
+    size_t size_bytes  = m_charged_size_bytes  = m_size_bytes;
+    size_t chunk_count = m_charged_chunk_count = m_chunk_serial;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for(auto q = m_local_map.begin(); q != m_local_map.end(); ++q)
+    {
+        Allocator* local = (*q).second;
+        size_bytes  += local->m_charged_size_bytes  = local->m_size_bytes;
+        chunk_count += local->m_charged_chunk_count = local->m_chunk_serial;
+    }
+    m_shared_size_bytes  = size_bytes;
+    m_shared_chunk_count = chunk_count;
+}
+
+// Chooses where pages come from and how large they are. Only takes effect while this
+// allocator holds no pages, so call it before the first allocation.
+bool Allocator::set_block_source(block_source_e block_source, size_t block_size_bytes, bool prefault)
+{
+    if(m_block_count || !m_page_vec.empty() || m_parent)
+        return false;
+    if(block_size_bytes < SLAB_SIZE_BYTES || block_size_bytes%SLAB_SIZE_BYTES)
+        return false;
+    m_block_source    = block_source;
+    m_page_size_bytes = block_size_bytes;
+    m_prefault        = prefault;
+    return true;
+}
+
+// Starts a checkpoint, everything allocated after it can be released with rollback.
+// Marks nest, and each must be resolved by rollback or commit in LIFO order. Chunks that
+// survive a rollback must not point at chunks allocated after the mark, e.g. a child
+// array that grew after the mark.
+Allocator::mark_t Allocator::mark()
+{
+    if(m_concurrent)
+        return _local().mark();
+    _drain_remote_frees(); // frees from before the mark must not be released against it
+    m_mark_stack.push_back(MarkState());
+    MarkState &mark_state = m_mark_stack.back();
+    mark_state.m_page_index          = m_page_index;
+    mark_state.m_slab_cur            = m_slab_cur;
+    mark_state.m_slab_end            = m_slab_end;
+    mark_state.m_serial              = m_serial;
+    mark_state.m_chunk_serial        = m_chunk_serial;
+    mark_state.m_size_bytes          = m_size_bytes;
+    mark_state.m_premark_freed_bytes = 0;
+    memcpy(mark_state.m_pool, m_pool, sizeof(m_pool));
+    memset(mark_state.m_deferred_list, 0, sizeof(mark_state.m_deferred_list));
+    if(m_mode == MODE_ARENA)
+    {
+        // only slots freed after the mark may be handed out again before it is resolved
+        for(size_t i = 0; i < 2; i++)
+            for(size_t j = 0; j < SIZE_CLASS_COUNT; j++)
+                m_pool[i][j].m_free_list = NULL;
+    }
+    DtorLink &dtor_sentinel = mark_state.m_dtor_sentinel;
+    dtor_sentinel.m_prev    = NULL;
+    dtor_sentinel.m_next    = m_dtor_list;
+    dtor_sentinel.m_dtor_cb = NULL;
+    if(m_dtor_list)
+        m_dtor_list->m_prev = &dtor_sentinel;
+    m_dtor_list = &dtor_sentinel;
+    SlabHeader &large_sentinel = mark_state.m_large_sentinel;
+    memset(&large_sentinel, 0, sizeof(large_sentinel));
+    large_sentinel.m_next = m_large_list;
+    if(m_large_list)
+        m_large_list->m_prev = &large_sentinel;
+    m_large_list = &large_sentinel;
+    return m_mark_stack.size()-1;
+}
+
+// Runs the dtors of, and releases, everything allocated since _mark. Later marks are rolled back too.
+void Allocator::rollback(mark_t _mark)
+{
+    if(m_concurrent)
+    {
+        _local().rollback(_mark);
+        return;
+    }
+    _drain_remote_frees();
+    while(m_mark_stack.size() > _mark)
+        _rollback_top();
+    if(m_root->_has_budget())
+        m_root->_charge(*this);
+}
+
+// Keeps everything allocated since _mark. Later marks are committed too.
+void Allocator::commit(mark_t _mark)
+{
+    if(m_concurrent)
+    {
+        _local().commit(_mark);
+        return;
+    }
+    _drain_remote_frees();
+    while(m_mark_stack.size() > _mark)
+        _commit_top();
 }
 
 void Allocator::dump(std::string indent) const
 {
+    if(m_concurrent)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for(auto q = m_local_map.begin(); q != m_local_map.end(); ++q)
+            (*q).second->dump(indent);
+        return;
+    }
     std::cout << '\"' << m_name << "\" {" << std::endl;
-    for(auto p = m_chunk_map.begin(); p != m_chunk_map.end(); ++p)
+    if(m_mode == MODE_ARENA)
+    {
+        std::cout << indent << "arena .. " << m_page_index << " of " << m_page_vec.size() << " pages, "
+                << m_large_count << " large chunks, "
+                << m_size_bytes << " bytes used, "
+                << m_dtor_count << " dtors" << std::endl;
+    }
+
+    // the same site may be interned once per translation unit
+    std::map<std::pair<std::string, std::pair<size_t, dtor_cb_t>>, AllocSite> merged_site_map;
+    for(auto p = m_site_map.begin(); p != m_site_map.end(); ++p)
     {
-        (*p).second->dump(indent);
+        const AllocSite &site = (*p).second;
+        auto q = merged_site_map.insert(std::make_pair(
+                std::make_pair(std::string(site.m_filename), std::make_pair(site.m_line_number, site.m_dtor_cb)),
+                site));
+        if(q.second)
+            continue;
+        AllocSite &merged_site = (*q.first).second;
+        merged_site.m_alloc_count += site.m_alloc_count;
+        merged_site.m_alloc_bytes += site.m_alloc_bytes;
+        merged_site.m_live_count  += site.m_live_count;
+        merged_site.m_live_bytes  += site.m_live_bytes;
+        merged_site.m_peak_bytes  += site.m_peak_bytes; // upper bound
+    }
+    std::vector<const AllocSite*> site_vec;
+    for(auto r = merged_site_map.begin(); r != merged_site_map.end(); ++r)
+        site_vec.push_back(&(*r).second);
+    std::stable_sort(site_vec.begin(), site_vec.end(),
+            [](const AllocSite* x, const AllocSite* y) {
+                if(x->m_live_bytes != y->m_live_bytes)
+                    return x->m_live_bytes > y->m_live_bytes;
+                return x->m_peak_bytes > y->m_peak_bytes;
+            });
+    for(auto t = site_vec.begin(); t != site_vec.end(); ++t)
+    {
+        (*t)->dump(indent);
         std::cout << std::endl;
     }
     std::cout << "};" << std::endl;
 }
 
+// the calling thread's child arena, created on first use
+Allocator &Allocator::_local()
+{
+    static thread_local size_t cached_id = 0;
+    static thread_local Allocator* cached_local = NULL;
+    if(cached_id == m_id)
+        return *cached_local;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Allocator* &local = m_local_map[std::this_thread::get_id()];
+    if(!local)
+        local = new Allocator(m_name, *this);
+    cached_id = m_id;
+    cached_local = local;
+    return *local;
+}
+
+size_t Allocator::_local_size() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    size_t size_bytes = 0;
+    for(auto q = m_local_map.begin(); q != m_local_map.end(); ++q)
+        size_bytes += (*q).second->size();
+    return size_bytes;
+}
+
+// the calling thread's arena allocates, and takes from the budget kept here
+void* Allocator::_malloc_concurrent(size_t size_bytes, const char* filename, size_t line_number,
+        MemChunk::dtor_cb_t dtor_cb)
+{
+    Allocator &local = _local();
+    local._drain_remote_frees();
+    void* ptr = local._malloc(size_bytes, filename, line_number, dtor_cb);
+    if(m_mode == MODE_TRACKING)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        OwnedChunk owned_chunk = {&local, dtor_cb, size_bytes};
+        m_owner_map[ptr] = owned_chunk;
+    }
+    return ptr;
 }
 
-void* operator new(size_t size_bytes, xl::Allocator &alloc, std::string filename, size_t line_number,
-        xl::MemChunk::dtor_cb_t dtor_cb)
+// A chunk allocated by another thread has its dtor run here, and goes back to its own arena
+// the next time that thread allocates.
+void Allocator::_free_concurrent(void* ptr, bool run_dtor)
 {
-    return alloc._malloc(size_bytes, filename, line_number, dtor_cb);
+    if(!ptr || m_resetting)
+        return;
+    Allocator &local = _local();
+    Allocator* owner = NULL;
+    dtor_cb_t dtor_cb = NULL;
+    if(m_mode == MODE_ARENA)
+    {
+        SlabHeader* header = reinterpret_cast<SlabHeader*>(
+                reinterpret_cast<uintptr_t>(ptr) & ~static_cast<uintptr_t>(SLAB_SIZE_BYTES-1));
+        owner = header->m_owner;
+        if(owner != &local && header->m_has_dtor)
+            dtor_cb = reinterpret_cast<DtorLink*>(reinterpret_cast<char*>(ptr)-DTOR_LINK_BYTES)->m_dtor_cb;
+    }
+    else
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto p = m_owner_map.find(ptr);
+        if(p == m_owner_map.end())
+            return;
+        owner   = (*p).second.m_owner;
+        dtor_cb = (*p).second.m_dtor_cb;
+        m_owner_map.erase(p);
+    }
+    if(owner == &local)
+    {
+        local._free(ptr, run_dtor);
+        return;
+    }
+    if(run_dtor && dtor_cb)
+        dtor_cb(ptr);
+    owner->_push_remote_free(ptr);
 }
 
-void* operator new(size_t size_bytes, xl::Allocator &alloc, std::string filename, size_t line_number)
+// Takes the bytes and the chunk from the budget before alloc allocates them, so that arenas
+// racing for the last bytes can't all get them. The size class may be larger than what was
+// asked for, the difference is charged next time.
+void Allocator::_take_budget(Allocator &alloc, size_t size_bytes)
 {
-    return alloc._malloc(size_bytes, filename, line_number, NULL);
+    _charge(alloc);
+    size_t chunk_count = m_shared_chunk_count++;
+    size_t shared_size_bytes = m_shared_size_bytes.fetch_add(size_bytes);
+    if(chunk_count >= m_max_chunks || size_bytes > m_max_bytes-std::min(shared_size_bytes, m_max_bytes))
+    {
+        m_shared_chunk_count--;
+        m_shared_size_bytes -= size_bytes;
+        throw BudgetExceeded(chunk_count >= m_max_chunks);
+    }
+    alloc.m_charged_chunk_count++;
+    alloc.m_charged_size_bytes += size_bytes;
+}
+
+// adds what an arena allocated or freed since it was last charged to the shared budget
+void Allocator::_charge(Allocator &alloc)
+{
+    m_shared_size_bytes  += alloc.m_size_bytes-alloc.m_charged_size_bytes;
+    m_shared_chunk_count += alloc.m_chunk_serial-alloc.m_charged_chunk_count;
+    alloc.m_charged_size_bytes  = alloc.m_size_bytes;
+    alloc.m_charged_chunk_count = alloc.m_chunk_serial;
+}
+
+// lock-free, the owning thread takes the whole list at once
+void Allocator::_push_remote_free(void* ptr)
+{
+    void* head = m_remote_free_list.load(std::memory_order_relaxed);
+    do
+    {
+        *reinterpret_cast<void**>(ptr) = head;
+    } while(!m_remote_free_list.compare_exchange_weak(head, ptr, std::memory_order_release,
+            std::memory_order_relaxed));
+}
+
+// the dtors already ran in the threads that freed the chunks
+void Allocator::_free_remote()
+{
+    void* ptr = m_remote_free_list.exchange(NULL, std::memory_order_acquire);
+    while(ptr)
+    {
+        void* next = *reinterpret_cast<void**>(ptr);
+        _free(ptr, false);
+        ptr = next;
+    }
+}
+
+AllocSite* Allocator::_intern_site(const char* filename, size_t line_number, MemChunk::dtor_cb_t dtor_cb)
+{
+    site_key_t key = {filename, line_number, dtor_cb};
+    auto p = m_site_map.find(key);
+    if(p == m_site_map.end())
+        p = m_site_map.insert(site_map_t::value_type(key, AllocSite(filename, line_number, dtor_cb))).first;
+    return &(*p).second;
+}
+
+void Allocator::_carve_slab(Pool &pool, size_t size_class, bool has_dtor)
+{
+    if(m_slab_cur == m_slab_end)
+    {
+        void* page = NULL;
+        if(m_page_index < m_page_vec.size())
+            page = m_page_vec[m_page_index];
+        else
+        {
+            page = _take_page();
+            m_page_vec.push_back(page);
+        }
+        m_page_index++;
+        m_slab_cur = reinterpret_cast<char*>(page);
+        m_slab_end = m_slab_cur+_page_size();
+    }
+    SlabHeader* header = reinterpret_cast<SlabHeader*>(m_slab_cur);
+    header->m_size_class = size_class;
+    header->m_has_dtor   = has_dtor;
+    header->m_serial     = m_serial++;
+    header->m_size_bytes = size_of_class(size_class);
+    header->m_prev = header->m_next = NULL;
+    header->m_owner = this;
+    pool.m_cur = m_slab_cur+SLAB_HEADER_BYTES;
+    pool.m_end = m_slab_cur+SLAB_SIZE_BYTES;
+    m_slab_cur += SLAB_SIZE_BYTES;
+}
+
+void* Allocator::_alloc_large(size_t size_bytes, bool has_dtor)
+{
+    SlabHeader* header = NULL;
+    for(SlabHeader** q = &m_large_free_list; *q; q = &(*q)->m_next)
+    {
+        if((*q)->m_size_bytes < size_bytes)
+            continue;
+        header = *q;
+        *q = header->m_next;
+        break;
+    }
+    if(!header)
+    {
+        void* mem = NULL;
+        if(posix_memalign(&mem, SLAB_SIZE_BYTES, SLAB_HEADER_BYTES+size_bytes))
+            throw std::bad_alloc();
+        header = reinterpret_cast<SlabHeader*>(mem);
+        header->m_size_bytes = size_bytes;
+    }
+    header->m_size_class = SIZE_CLASS_COUNT;
+    header->m_has_dtor   = has_dtor;
+    header->m_serial     = m_serial++;
+    header->m_owner      = this;
+    header->m_prev = NULL;
+    header->m_next = m_large_list;
+    if(m_large_list)
+        m_large_list->m_prev = header;
+    m_large_list = header;
+    m_large_count++;
+    m_size_bytes += header->m_size_bytes;
+    return reinterpret_cast<char*>(header)+SLAB_HEADER_BYTES;
+}
+
+void Allocator::_free_arena(void* ptr, bool run_dtor)
+{
+    if(!ptr)
+        return;
+    SlabHeader* header = reinterpret_cast<SlabHeader*>(
+            reinterpret_cast<uintptr_t>(ptr) & ~static_cast<uintptr_t>(SLAB_SIZE_BYTES-1));
+    char* slot = reinterpret_cast<char*>(ptr);
+    if(header->m_has_dtor)
+    {
+        slot -= DTOR_LINK_BYTES;
+        DtorLink* link = reinterpret_cast<DtorLink*>(slot);
+        _unlink_dtor(link);
+        m_dtor_count--;
+        if(run_dtor)
+            link->m_dtor_cb(ptr);
+    }
+    m_size_bytes -= header->m_size_bytes;
+    for(auto p = m_mark_stack.rbegin(); p != m_mark_stack.rend() && _is_before_mark(*p, header, slot); ++p)
+        (*p).m_premark_freed_bytes += header->m_size_bytes;
+    if(header->m_size_class == SIZE_CLASS_COUNT)
+    {
+        _unlink_large(header);
+        m_large_count--;
+        free(header);
+        return;
+    }
+    _release_slot(header, slot);
+}
+
+void Allocator::_unlink_dtor(DtorLink* link)
+{
+    if(link->m_prev)
+        link->m_prev->m_next = link->m_next;
+    else
+        m_dtor_list = link->m_next;
+    if(link->m_next)
+        link->m_next->m_prev = link->m_prev;
+}
+
+void Allocator::_unlink_large(SlabHeader* header)
+{
+    if(header->m_prev)
+        header->m_prev->m_next = header->m_next;
+    else
+        m_large_list = header->m_next;
+    if(header->m_next)
+        header->m_next->m_prev = header->m_prev;
+}
+
+bool Allocator::_is_before_mark(const MarkState &mark_state, const SlabHeader* header, const void* slot) const
+{
+    if(header->m_serial >= mark_state.m_serial)
+        return false;
+    if(header->m_size_class == SIZE_CLASS_COUNT)
+        return true;
+    // the slab a pool was bumping through at mark time is split by its bump pointer
+    const Pool &pool = mark_state.m_pool[header->m_has_dtor][header->m_size_class];
+    if(pool.m_end && reinterpret_cast<const char*>(header)+SLAB_SIZE_BYTES == pool.m_end)
+        return slot < pool.m_cur;
+    return true;
+}
+
+// Slots that outlive a rollback of the innermost mark can't be reused until it is resolved.
+void Allocator::_release_slot(SlabHeader* header, void* slot)
+{
+    void** list = NULL;
+    if(!m_mark_stack.empty() && _is_before_mark(m_mark_stack.back(), header, slot))
+        list = &m_mark_stack.back().m_deferred_list[header->m_has_dtor][header->m_size_class];
+    else
+        list = &m_pool[header->m_has_dtor][header->m_size_class].m_free_list;
+    *reinterpret_cast<void**>(slot) = *list;
+    *list = slot;
+}
+
+// Drops the innermost mark, its deferred slots are released against the next one out.
+void Allocator::_pop_mark()
+{
+    void* deferred_list[2][SIZE_CLASS_COUNT];
+    memcpy(deferred_list, m_mark_stack.back().m_deferred_list, sizeof(deferred_list));
+    m_mark_stack.pop_back();
+    for(size_t i = 0; i < 2; i++)
+    {
+        for(size_t j = 0; j < SIZE_CLASS_COUNT; j++)
+        {
+            for(void* slot = deferred_list[i][j]; slot;)
+            {
+                void* next = *reinterpret_cast<void**>(slot);
+                _release_slot(reinterpret_cast<SlabHeader*>(
+                        reinterpret_cast<uintptr_t>(slot) & ~static_cast<uintptr_t>(SLAB_SIZE_BYTES-1)), slot);
+                slot = next;
+            }
+        }
+    }
+}
+
+void Allocator::_rollback_top()
+{
+    MarkState &mark_state = m_mark_stack.back();
+    if(m_mode == MODE_TRACKING)
+    {
+        std::vector<std::pair<size_t, void*>> chunk_vec; // serial, ptr
+        for(auto p = m_chunk_map.begin(); p != m_chunk_map.end(); ++p)
+        {
+            if((*p).second->serial() >= mark_state.m_chunk_serial)
+                chunk_vec.push_back(std::make_pair((*p).second->serial(), (*p).first));
+        }
+        std::sort(chunk_vec.rbegin(), chunk_vec.rend());
+        for(auto q = chunk_vec.begin(); q != chunk_vec.end(); ++q)
+        {
+            auto r = m_chunk_map.find((*q).second);
+            if(r == m_chunk_map.end())
+                continue; // already freed by a dtor
+            MemChunk* chunk = (*r).second;
+            m_size_bytes -= chunk->size();
+            m_chunk_map.erase(r);
+            delete chunk;
+        }
+    }
+    m_chunk_serial = mark_state.m_chunk_serial;
+    while(m_dtor_list != &mark_state.m_dtor_sentinel)
+    {
+        DtorLink* link = m_dtor_list;
+        m_dtor_list = link->m_next;
+        m_dtor_list->m_prev = NULL; // a dtor may free the next chunk, which then unlinks as the head
+        m_dtor_count--;
+        link->m_dtor_cb(reinterpret_cast<char*>(link)+DTOR_LINK_BYTES);
+    }
+    m_dtor_list = mark_state.m_dtor_sentinel.m_next;
+    if(m_dtor_list)
+        m_dtor_list->m_prev = NULL;
+    while(m_large_list != &mark_state.m_large_sentinel)
+    {
+        SlabHeader* header = m_large_list;
+        m_large_list = header->m_next;
+        header->m_next = m_large_free_list;
+        m_large_free_list = header;
+        m_large_count--;
+    }
+    m_large_list = mark_state.m_large_sentinel.m_next;
+    if(m_large_list)
+        m_large_list->m_prev = NULL;
+    if(m_mode == MODE_ARENA)
+    {
+        m_page_index = mark_state.m_page_index;
+        m_slab_cur   = mark_state.m_slab_cur;
+        m_slab_end   = mark_state.m_slab_end;
+        m_serial     = mark_state.m_serial;
+        m_size_bytes = mark_state.m_size_bytes-mark_state.m_premark_freed_bytes;
+        memcpy(m_pool, mark_state.m_pool, sizeof(m_pool));
+    }
+    _pop_mark();
+}
+
+void Allocator::_commit_top()
+{
+    MarkState &mark_state = m_mark_stack.back();
+    _unlink_dtor(&mark_state.m_dtor_sentinel);
+    _unlink_large(&mark_state.m_large_sentinel);
+    if(m_mode == MODE_ARENA)
+    {
+        // slots freed before the mark go back behind those freed since
+        for(size_t i = 0; i < 2; i++)
+        {
+            for(size_t j = 0; j < SIZE_CLASS_COUNT; j++)
+            {
+                void** tail = &m_pool[i][j].m_free_list;
+                while(*tail)
+                    tail = reinterpret_cast<void**>(*tail);
+                *tail = mark_state.m_pool[i][j].m_free_list;
+            }
+        }
+    }
+    _pop_mark();
+}
+
+void Allocator::_reset_arena(size_t max_retained_bytes)
+{
+    while(m_dtor_list)
+    {
+        DtorLink* link = m_dtor_list;
+        m_dtor_list = link->m_next;
+        if(m_dtor_list)
+            m_dtor_list->m_prev = NULL; // same as in _rollback_top
+        link->m_dtor_cb(reinterpret_cast<char*>(link)+DTOR_LINK_BYTES);
+    }
+    m_dtor_count = 0;
+    size_t page_size_bytes = _page_size();
+    size_t retained_bytes = 0;
+    size_t retained_page_count = 0;
+    for(auto p = m_page_vec.begin(); p != m_page_vec.end(); ++p)
+    {
+        if(retained_bytes+page_size_bytes <= max_retained_bytes)
+        {
+            // a retained page left untouched since the last reset gives its memory back,
+            // but keeps its address range
+            if(!m_parent && m_block_source != BLOCK_MALLOC &&
+                    static_cast<size_t>(p-m_page_vec.begin()) >= m_page_index)
+                madvise(*p, m_page_size_bytes, MADV_DONTNEED);
+            m_page_vec[retained_page_count++] = *p;
+            retained_bytes += page_size_bytes;
+            continue;
+        }
+        if(m_parent)
+            m_parent->_return_page(*p);
+        else
+            _free_block(*p);
+    }
+    m_page_vec.resize(retained_page_count);
+    m_page_index = 0;
+    m_slab_cur = m_slab_end = NULL;
+    memset(m_pool, 0, sizeof(m_pool));
+    while(m_large_list)
+    {
+        SlabHeader* header = m_large_list;
+        m_large_list = header->m_next;
+        header->m_next = m_large_free_list;
+        m_large_free_list = header;
+    }
+    m_large_count = 0;
+    for(SlabHeader** q = &m_large_free_list; *q;)
+    {
+        SlabHeader* header = *q;
+        if(retained_bytes+header->m_size_bytes <= max_retained_bytes)
+        {
+            retained_bytes += header->m_size_bytes;
+            q = &header->m_next;
+            continue;
+        }
+        *q = header->m_next;
+        free(header);
+    }
+}
+
+// hands out a retained page that isn't in use, so a child arena reuses its parent's pages
+void* Allocator::_take_page()
+{
+    std::unique_lock<std::mutex> lock(m_mutex, std::defer_lock);
+    if(m_concurrent)
+        lock.lock(); // refills are one page at a time, so this is rarely contended
+    void* page = NULL;
+    if(m_page_index < m_page_vec.size())
+    {
+        page = m_page_vec.back();
+        m_page_vec.pop_back();
+        return page;
+    }
+    if(m_parent)
+        return m_parent->_take_page();
+    return _alloc_block();
+}
+
+void* Allocator::_alloc_block()
+{
+    char* page = NULL;
+    if(m_block_source == BLOCK_MALLOC)
+    {
+        void* mem = NULL;
+        if(posix_memalign(&mem, SLAB_SIZE_BYTES, m_page_size_bytes))
+            throw std::bad_alloc();
+        page = reinterpret_cast<char*>(mem);
+    }
+    else
+    {
+        // over-map, then trim to an aligned block so it can be backed by huge pages
+        size_t align_bytes = SLAB_SIZE_BYTES;
+        if(m_block_source == BLOCK_MMAP_HUGE && m_page_size_bytes%HUGE_PAGE_SIZE_BYTES == 0)
+            align_bytes = HUGE_PAGE_SIZE_BYTES;
+        size_t map_size_bytes = m_page_size_bytes+align_bytes-SLAB_SIZE_BYTES;
+        void* mem = mmap(NULL, map_size_bytes, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+        if(mem == MAP_FAILED)
+            throw std::bad_alloc();
+        char* map_begin = reinterpret_cast<char*>(mem);
+        char* map_end   = map_begin+map_size_bytes;
+        page = reinterpret_cast<char*>(
+                (reinterpret_cast<uintptr_t>(map_begin)+align_bytes-1) & ~static_cast<uintptr_t>(align_bytes-1));
+        if(page > map_begin)
+            munmap(map_begin, page-map_begin);
+        if(page+m_page_size_bytes < map_end)
+            munmap(page+m_page_size_bytes, map_end-(page+m_page_size_bytes));
+#ifdef MADV_HUGEPAGE
+        if(m_block_source == BLOCK_MMAP_HUGE)
+            madvise(page, m_page_size_bytes, MADV_HUGEPAGE);
+#endif
+    }
+    if(m_prefault)
+    {
+        for(char* p = page; p < page+m_page_size_bytes; p += SLAB_SIZE_BYTES)
+            *p = 0;
+    }
+    m_block_count++;
+    return page;
+}
+
+void Allocator::_free_block(void* page)
+{
+    if(m_block_source == BLOCK_MALLOC)
+        free(page);
+    else
+        munmap(page, m_page_size_bytes);
+    m_block_count--;
+}
+
+void Allocator::_return_page(void* page)
+{
+    std::unique_lock<std::mutex> lock(m_mutex, std::defer_lock);
+    if(m_concurrent)
+        lock.lock();
+    m_page_vec.push_back(page);
+}
+
 }
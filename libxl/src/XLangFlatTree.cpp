@@ -0,0 +1,177 @@
+// XLang
+// -- A parser framework for language modeling
+// Copyright (C) 2011 onlyuser <mailto:onlyuser@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+#include "node/XLangFlatTree.h" // node::FlatTree
+#include "XLangType.h" // uint32_t
+#include <sstream> // std::stringstream
+#include <string> // std::string
+#include <vector> // std::vector
+
+// prototype
+extern std::string id_to_name(uint32_t lexer_id);
+
+namespace xl { namespace node {
+
+FlatTree::FlatTree(const NodeIdentIFace* root)
+{
+    struct pending_t
+    {
+        const NodeIdentIFace* m_node;
+        int32_t               m_parent;
+        uint32_t              m_child_pos; // in m_child_vec, when m_parent is set
+    };
+    std::vector<pending_t> stack;
+    pending_t root_pending = {root, -1, 0};
+    stack.push_back(root_pending);
+    while(!stack.empty())
+    {
+        pending_t pending = stack.back();
+        stack.pop_back();
+        uint32_t index = m_type_vec.size();
+        if(pending.m_parent != -1)
+            m_child_vec[pending.m_child_pos] = index;
+        const NodeIdentIFace* _node = pending.m_node;
+        value_t value;
+        value.m_children.m_offset = 0;
+        value.m_children.m_count  = 0;
+        m_type_vec.push_back(_node ? static_cast<uint8_t>(_node->type()) : NIL);
+        m_lexer_id_vec.push_back(_node ? _node->lexer_id() : 0);
+        m_parent_vec.push_back(pending.m_parent);
+        m_subtree_size_vec.push_back(1);
+        if(_node)
+        {
+            switch(_node->type())
+            {
+                case NodeIdentIFace::INT:
+                    value.m_int = node_cast<TermNodeIFace<NodeIdentIFace::INT>>(_node)->value();
+                    break;
+                case NodeIdentIFace::FLOAT:
+                    value.m_float = node_cast<TermNodeIFace<NodeIdentIFace::FLOAT>>(_node)->value();
+                    break;
+                case NodeIdentIFace::STRING:
+                    value.m_string = node_cast<TermNodeIFace<NodeIdentIFace::STRING>>(_node)->value();
+                    break;
+                case NodeIdentIFace::CHAR:
+                    value.m_char = node_cast<TermNodeIFace<NodeIdentIFace::CHAR>>(_node)->value();
+                    break;
+                case NodeIdentIFace::IDENT:
+                    value.m_ident = node_cast<TermNodeIFace<NodeIdentIFace::IDENT>>(_node)->value();
+                    break;
+                case NodeIdentIFace::SYMBOL:
+                    {
+                        auto symbol = node_cast<SymbolNodeIFace>(_node);
+                        size_t n = symbol->size();
+                        value.m_children.m_offset = m_child_vec.size();
+                        value.m_children.m_count  = n;
+                        m_child_vec.resize(m_child_vec.size()+n);
+                        for(size_t i = n; i > 0; i--) // reversed, so the first child is popped first
+                        {
+                            pending_t child_pending = {(*symbol)[i-1], static_cast<int32_t>(index),
+                                    value.m_children.m_offset+static_cast<uint32_t>(i-1)};
+                            stack.push_back(child_pending);
+                        }
+                    }
+                    break;
+            }
+        }
+        m_value_vec.push_back(value);
+    }
+    for(size_t i = m_type_vec.size()-1; i > 0; i--)
+        m_subtree_size_vec[m_parent_vec[i]] += m_subtree_size_vec[i];
+}
+
+std::string FlatNode::name() const
+{
+    return id_to_name(lexer_id());
+}
+
+NodeIdentIFace* FlatNode::parent() const
+{
+    int parent_index = m_tree->parent(m_index);
+    if(parent_index == -1)
+        return NULL;
+    return const_cast<FlatNode*>(&m_nodes[parent_index]);
+}
+
+std::string FlatNode::uid() const
+{
+    std::stringstream ss;
+    ss << '_' << m_index;
+    return ss.str();
+}
+
+NodeIdentIFace* FlatNode::operator[](uint32_t index) const
+{
+    size_t child_index = m_tree->child(m_index, index);
+    if(m_tree->type(child_index) == FlatTree::NIL)
+        return NULL;
+    return const_cast<FlatNode*>(&m_nodes[child_index]);
+}
+
+const void* FlatNode::typed_iface() const
+{
+    switch(m_tree->type(m_index))
+    {
+        case NodeIdentIFace::INT:    return static_cast<const TermNodeIFace<NodeIdentIFace::INT>*>(this);
+        case NodeIdentIFace::FLOAT:  return static_cast<const TermNodeIFace<NodeIdentIFace::FLOAT>*>(this);
+        case NodeIdentIFace::STRING: return static_cast<const TermNodeIFace<NodeIdentIFace::STRING>*>(this);
+        case NodeIdentIFace::CHAR:   return static_cast<const TermNodeIFace<NodeIdentIFace::CHAR>*>(this);
+        case NodeIdentIFace::IDENT:  return static_cast<const TermNodeIFace<NodeIdentIFace::IDENT>*>(this);
+        case NodeIdentIFace::SYMBOL: return static_cast<const SymbolNodeIFace*>(this);
+    }
+    return NULL;
+}
+
+int FlatNode::index() const
+{
+    int parent_index = m_tree->parent(m_index);
+    if(parent_index == -1)
+        return -1;
+    return m_nodes[parent_index].index_of(this);
+}
+
+// same as the pointer tree's, not cached
+size_t FlatNode::hash() const
+{
+    switch(m_tree->type(m_index))
+    {
+        case NodeIdentIFace::INT:    return TermNodeIFace<NodeIdentIFace::INT>::hash();
+        case NodeIdentIFace::FLOAT:  return TermNodeIFace<NodeIdentIFace::FLOAT>::hash();
+        case NodeIdentIFace::STRING: return TermNodeIFace<NodeIdentIFace::STRING>::hash();
+        case NodeIdentIFace::CHAR:   return TermNodeIFace<NodeIdentIFace::CHAR>::hash();
+        case NodeIdentIFace::IDENT:  return TermNodeIFace<NodeIdentIFace::IDENT>::hash();
+        case NodeIdentIFace::SYMBOL: return SymbolNodeIFace::hash();
+    }
+    return 1;
+}
+
+FlatTreeView::FlatTreeView(const FlatTree &tree)
+{
+    m_node_vec.reserve(tree.size()); // never reallocated, the nodes point into it
+    for(size_t i = 0; i < tree.size(); i++)
+        m_node_vec.push_back(FlatNode(m_node_vec.data(), &tree, i));
+}
+
+const NodeIdentIFace* FlatTreeView::node(size_t index) const
+{
+    if(m_node_vec[index].tree()->type(index) == FlatTree::NIL)
+        return NULL;
+    return &m_node_vec[index];
+}
+
+} }
@@ -0,0 +1,177 @@
+// XLang
+// -- A parser framework for language modeling
+// Copyright (C) 2011 onlyuser <mailto:onlyuser@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#include "XLangInternTable.h" // InternTable
+#include <string> // std::string
+#include <vector> // std::vector
+#include <mutex> // std::mutex, std::lock_guard
+#include <string.h> // memcmp
+#include <stdint.h> // uint64_t
+#include <type_traits> // std::is_standard_layout
+
+namespace xl {
+
+size_t hash_string(const char* s, size_t n)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for(size_t i = 0; i < n; i++)
+    {
+        hash ^= static_cast<unsigned char>(s[i]);
+        hash *= 1099511628211ULL;
+    }
+    return static_cast<size_t>(hash);
+}
+
+const std::string* InternTable::find(const char* s, size_t n, size_t hash) const
+{
+    return m_index.find(s, n, hash);
+}
+
+// The string must not be in the table yet. Short strings are kept inside the std::string
+// itself, so their bytes live in the arena chunk.
+const std::string* InternTable::insert(const char* s, size_t n, size_t hash)
+{
+    const std::string* unique_string = &(new (PNEW(m_alloc, xl::InternTable::, atom_t))
+            atom_t(s, n, m_base_id+m_string_vec.size()))->m_string;
+    m_index.insert(unique_string, hash);
+    m_string_vec.push_back(unique_string);
+    return unique_string;
+}
+
+// Forgets the strings interned after the first count, latest first. Their chunks are
+// left to the allocator, and their atom ids are reused.
+void InternTable::trim(size_t count)
+{
+    while(m_string_vec.size() > count)
+    {
+        const std::string* unique_string = m_string_vec.back();
+        m_index.erase(unique_string, hash_string(unique_string->data(), unique_string->size()));
+        m_string_vec.pop_back();
+    }
+}
+
+// only valid for strings from an InternTable
+uint32_t InternTable::atom_id(const std::string* unique_string)
+{
+    static_assert(std::is_standard_layout<atom_t>::value, "atom_t must start with its string");
+    return reinterpret_cast<const atom_t*>(unique_string)->m_id;
+}
+
+InternPool::InternPool(std::string name)
+    : m_alloc(name), m_table(NULL), m_size(0)
+{
+    m_table.store(_new_table(64), std::memory_order_release);
+}
+
+InternPool::~InternPool()
+{
+    for(auto p = m_table_vec.begin(); p != m_table_vec.end(); p++)
+    {
+        delete[] (*p)->m_slots;
+        delete *p;
+    }
+}
+
+// Wait-free, a probe ends at the first empty slot of whichever table was current. A string
+// inserted into a newer table is missed, and the caller interns its own copy. Strings added
+// after a TreeContext took its snapshot have atom ids that clash with that context's own,
+// so it only looks below max_count.
+const std::string* InternPool::find(const char* s, size_t n, size_t hash, size_t max_count) const
+{
+    const std::string* unique_string = _find(m_table.load(std::memory_order_acquire), s, n, hash);
+    if(unique_string && InternTable::atom_id(unique_string) < max_count)
+        return unique_string;
+    return NULL;
+}
+
+const std::string* InternPool::alloc_unique_string(const char* s, size_t n)
+{
+    size_t hash = hash_string(s, n);
+    const std::string* unique_string = _find(m_table.load(std::memory_order_acquire), s, n, hash);
+    if(unique_string)
+        return unique_string;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    table_t* table = m_table.load(std::memory_order_relaxed);
+    unique_string = _find(table, s, n, hash); // may have been added since
+    if(unique_string)
+        return unique_string;
+    size_t size = m_size.load(std::memory_order_relaxed);
+    if((size+1)*2 > table->m_mask+1)
+    {
+        _grow();
+        table = m_table.load(std::memory_order_relaxed);
+    }
+    unique_string = &(new (PNEW(m_alloc, xl::InternTable::, atom_t))
+            InternTable::atom_t(s, n, size))->m_string;
+    size_t index = hash & table->m_mask;
+    while(table->m_slots[index].m_string.load(std::memory_order_relaxed))
+        index = (index+1) & table->m_mask;
+    table->m_slots[index].m_hash = hash;
+    table->m_slots[index].m_string.store(unique_string, std::memory_order_release);
+    m_size.store(size+1, std::memory_order_release);
+    return unique_string;
+}
+
+const std::string* InternPool::_find(const table_t* table, const char* s, size_t n, size_t hash) const
+{
+    for(size_t index = hash & table->m_mask;; index = (index+1) & table->m_mask)
+    {
+        const slot_t &slot = table->m_slots[index];
+        const std::string* unique_string = slot.m_string.load(std::memory_order_acquire);
+        if(!unique_string)
+            return NULL;
+        if(slot.m_hash == hash && unique_string->size() == n && !memcmp(unique_string->data(), s, n))
+            return unique_string;
+    }
+}
+
+InternPool::table_t* InternPool::_new_table(size_t slot_count)
+{
+    table_t* table = new table_t;
+    table->m_mask  = slot_count-1;
+    table->m_slots = new slot_t[slot_count];
+    for(size_t i = 0; i < slot_count; i++)
+    {
+        table->m_slots[i].m_hash = 0;
+        table->m_slots[i].m_string.store(NULL, std::memory_order_relaxed);
+    }
+    m_table_vec.push_back(table);
+    return table;
+}
+
+// Fills a table twice the size, then publishes it. Readers still probing the old one see
+// every string it had.
+void InternPool::_grow()
+{
+    table_t* old_table = m_table.load(std::memory_order_relaxed);
+    table_t* table = _new_table((old_table->m_mask+1)*2);
+    for(size_t i = 0; i <= old_table->m_mask; i++)
+    {
+        const slot_t &old_slot = old_table->m_slots[i];
+        const std::string* unique_string = old_slot.m_string.load(std::memory_order_relaxed);
+        if(!unique_string)
+            continue;
+        size_t index = old_slot.m_hash & table->m_mask;
+        while(table->m_slots[index].m_string.load(std::memory_order_relaxed))
+            index = (index+1) & table->m_mask;
+        table->m_slots[index].m_hash = old_slot.m_hash;
+        table->m_slots[index].m_string.store(unique_string, std::memory_order_relaxed);
+    }
+    m_table.store(table, std::memory_order_release);
+}
+
+}
@@ -19,10 +19,12 @@
 #include "XLangTreeContext.h" // TreeContext
 #include "node/XLangNode.h" // node::NodeIdentIFace
 #include "XLangString.h" // xl::unescape_xml
+#include "XLangInternTable.h" // hash_string, hash_combine
 #include "XLangType.h" // uint32_t
 #include <stdarg.h> // va_list
 #include <string> // std::string
 #include <vector> // std::vector
+#include <unordered_map> // std::unordered_map
 
 #ifdef INCLUDE_PATH_EXTERN
     #define TIXML_USE_TICPP
@@ -41,29 +43,119 @@ node::SymbolNode* MVCModel::make_symbol(TreeContext* tc, uint32_t lexer_id, size
 {
     va_list ap;
     va_start(ap, size);
+    if(tc->hash_cons())
+    {
+        std::vector<node::NodeIdentIFace*> vec(size);
+        for(size_t i = 0; i<size; i++)
+            vec[i] = va_arg(ap, node::NodeIdentIFace*);
+        va_end(ap);
+        return make_symbol(tc, lexer_id, vec);
+    }
     node::SymbolNode* node = new (PNEW(tc->alloc(), node::, NodeIdentIFace))
-            node::SymbolNode(lexer_id, size, ap);
+            node::SymbolNode(tc, lexer_id, size, ap);
     va_end(ap);
     return node;
 }
 
+// The key is the child list SymbolNode keeps, after it drops eol() and flattens same-type
+// children into it.
 node::SymbolNode* MVCModel::make_symbol(TreeContext* tc, uint32_t lexer_id, std::vector<node::NodeIdentIFace*>& vec)
 {
-    return new (PNEW(tc->alloc(), node::, NodeIdentIFace))
-            node::SymbolNode(lexer_id, vec);
+    if(!tc->hash_cons())
+    {
+        return new (PNEW(tc->alloc(), node::, NodeIdentIFace))
+                node::SymbolNode(tc, lexer_id, vec);
+    }
+    std::vector<node::NodeIdentIFace*> child_vec;
+    child_vec.reserve(vec.size());
+    for(auto p = vec.begin(); p != vec.end(); ++p)
+    {
+        node::NodeIdentIFace* child = *p;
+        if(child == node::SymbolNode::eol())
+            continue;
+        if(child && child->type() == node::NodeIdentIFace::SYMBOL && child->lexer_id() == lexer_id)
+        {
+            auto child_symbol = node::node_cast<node::SymbolNodeIFace>(child);
+            for(size_t i = 0; i<child_symbol->size(); i++)
+                child_vec.push_back((*child_symbol)[i]);
+            continue;
+        }
+        child_vec.push_back(child);
+    }
+    size_t hash = hash_combine(hash_string(reinterpret_cast<const char*>(child_vec.data()),
+            child_vec.size()*sizeof(node::NodeIdentIFace*)), lexer_id);
+    node::NodeIdentIFace* shared_node = tc->find_node(hash, [&](const node::NodeIdentIFace* _node) {
+            if(_node->type() != node::NodeIdentIFace::SYMBOL || _node->lexer_id() != lexer_id)
+                return false;
+            auto symbol = node::node_cast<node::SymbolNodeIFace>(_node);
+            if(symbol->size() != child_vec.size())
+                return false;
+            for(size_t i = 0; i<child_vec.size(); i++)
+            {
+                if((*symbol)[i] != child_vec[i])
+                    return false;
+            }
+            return true;
+        });
+    if(shared_node)
+        return static_cast<node::SymbolNode*>(node::node_cast<node::SymbolNodeIFace>(shared_node));
+    node::SymbolNode* node = new (PNEW(tc->alloc(), node::, NodeIdentIFace))
+            node::SymbolNode(tc, lexer_id, vec);
+    tc->insert_node(hash, node);
+    return node;
+}
+
+template<class T>
+node::NodeIdentIFace* MVCModel::_make_shared_term(TreeContext* tc, uint32_t lexer_id, T value)
+{
+    node::TermNode<static_cast<node::NodeIdentIFace::type_t>(node::TermType<T>::type)> key(lexer_id, value);
+    size_t hash = key.hash();
+    node::NodeIdentIFace* shared_node = tc->find_node(hash, [&](const node::NodeIdentIFace* _node) {
+            return key.compare(_node);
+        });
+    if(shared_node)
+        return shared_node;
+    node::NodeIdentIFace* node = new_term(tc, lexer_id, value);
+    tc->insert_node(hash, node);
+    return node;
+}
+
+node::NodeIdentIFace* MVCModel::make_shared_term(TreeContext* tc, uint32_t lexer_id, long value)
+{
+    return _make_shared_term(tc, lexer_id, value);
+}
+
+node::NodeIdentIFace* MVCModel::make_shared_term(TreeContext* tc, uint32_t lexer_id, float32_t value)
+{
+    return _make_shared_term(tc, lexer_id, value);
+}
+
+node::NodeIdentIFace* MVCModel::make_shared_term(TreeContext* tc, uint32_t lexer_id, const InlineString* value)
+{
+    return _make_shared_term(tc, lexer_id, value);
+}
+
+node::NodeIdentIFace* MVCModel::make_shared_term(TreeContext* tc, uint32_t lexer_id, char value)
+{
+    return _make_shared_term(tc, lexer_id, value);
+}
+
+node::NodeIdentIFace* MVCModel::make_shared_term(TreeContext* tc, uint32_t lexer_id, const std::string* value)
+{
+    return _make_shared_term(tc, lexer_id, value);
 }
 
 template<>
-node::NodeIdentIFace* MVCModel::make_term<
+node::NodeIdentIFace* MVCModel::new_term<
         node::TermInternalType<node::NodeIdentIFace::STRING>::type
         >(TreeContext* tc, uint32_t lexer_id, node::TermInternalType<node::NodeIdentIFace::STRING>::type value)
 {
-    return new (PNEW(tc->alloc(), node::, NodeIdentIFace))
-            node::TermNode<node::NodeIdentIFace::STRING>(lexer_id, value); // supports non-trivial dtor
+    return new (PNEW_LOC(tc->alloc()))
+            node::TermNode<node::NodeIdentIFace::STRING>(lexer_id, value); // assumes trivial dtor
 }
 
 template<>
-node::NodeIdentIFace* MVCModel::make_term<
+node::NodeIdentIFace* MVCModel::new_term<
         node::TermInternalType<node::NodeIdentIFace::IDENT>::type
         >(TreeContext* tc, uint32_t lexer_id, node::TermInternalType<node::NodeIdentIFace::IDENT>::type value)
 {
@@ -71,6 +163,95 @@ node::NodeIdentIFace* MVCModel::make_term<
             node::TermNode<node::NodeIdentIFace::IDENT>(lexer_id, value); // supports non-trivial dtor
 }
 
+// Copies the subtree and the strings it refers to into tc, nodes in preorder, so the copy
+// refers to nothing outside tc. Unlike clone(), the source's arena can be released right after,
+// and a tc with a fresh allocator holds the subtree packed. A node reached through several parents
+// is copied once, and its copy is shared the same way, keeping the first parent it was reached
+// through. hash_cons() and lazy_clone() do not apply.
+node::NodeIdentIFace* MVCModel::extract(TreeContext* tc, const node::NodeIdentIFace* _node)
+{
+    struct pending_t
+    {
+        const node::NodeIdentIFace* m_node;
+        node::SymbolNode*           m_parent; // copy to append to
+    };
+    node::NodeIdentIFace* root = NULL;
+    std::unordered_map<const node::NodeIdentIFace*, node::NodeIdentIFace*> copy_map; // source, copy
+    std::vector<pending_t> stack;
+    pending_t root_pending = {_node, NULL};
+    stack.push_back(root_pending);
+    while(!stack.empty())
+    {
+        pending_t pending = stack.back();
+        stack.pop_back();
+        const node::NodeIdentIFace* source = pending.m_node;
+        node::NodeIdentIFace* copy = NULL;
+        auto q = source ? copy_map.find(source) : copy_map.end();
+        if(q != copy_map.end())
+        {
+            node::NodeIdentIFace* shared_copy = (*q).second;
+            node::NodeIdentIFace* first_parent = shared_copy->parent();
+            int first_slot = shared_copy->slot();
+            pending.m_parent->push_back(shared_copy);
+            shared_copy->set_parent(first_parent);
+            shared_copy->set_slot(first_slot);
+            shared_copy->set_shared(true);
+            continue;
+        }
+        if(source)
+        {
+            uint32_t lexer_id = source->lexer_id();
+            switch(source->type())
+            {
+                case node::NodeIdentIFace::INT:
+                    copy = new_term(tc, lexer_id,
+                            node::node_cast<node::TermNodeIFace<node::NodeIdentIFace::INT>>(source)->value());
+                    break;
+                case node::NodeIdentIFace::FLOAT:
+                    copy = new_term(tc, lexer_id,
+                            node::node_cast<node::TermNodeIFace<node::NodeIdentIFace::FLOAT>>(source)->value());
+                    break;
+                case node::NodeIdentIFace::STRING:
+                    {
+                        const InlineString* value =
+                                node::node_cast<node::TermNodeIFace<node::NodeIdentIFace::STRING>>(source)->value();
+                        copy = new_term(tc, lexer_id, tc->alloc_string(value->data(), value->size()));
+                    }
+                    break;
+                case node::NodeIdentIFace::CHAR:
+                    copy = new_term(tc, lexer_id,
+                            node::node_cast<node::TermNodeIFace<node::NodeIdentIFace::CHAR>>(source)->value());
+                    break;
+                case node::NodeIdentIFace::IDENT:
+                    copy = new_term(tc, lexer_id, tc->alloc_unique_string(
+                            *node::node_cast<node::TermNodeIFace<node::NodeIdentIFace::IDENT>>(source)->value()));
+                    break;
+                case node::NodeIdentIFace::SYMBOL:
+                    {
+                        auto source_symbol = node::node_cast<node::SymbolNodeIFace>(source);
+                        va_list ap;
+                        node::SymbolNode* copy_symbol = new (PNEW(tc->alloc(), node::, NodeIdentIFace))
+                                node::SymbolNode(tc, lexer_id, 0, ap);
+                        copy_symbol->reserve(source_symbol->size());
+                        for(size_t i = source_symbol->size(); i > 0; i--) // reversed, so the first child is copied first
+                        {
+                            pending_t child_pending = {(*source_symbol)[i-1], copy_symbol};
+                            stack.push_back(child_pending);
+                        }
+                        copy = copy_symbol;
+                    }
+                    break;
+            }
+            copy_map.insert(std::make_pair(source, copy));
+        }
+        if(pending.m_parent)
+            pending.m_parent->push_back(copy);
+        else
+            root = copy;
+    }
+    return root;
+}
+
 #ifdef TIXML_USE_TICPP
 static node::NodeIdentIFace* _make_term_from_typename(
         TreeContext* tc, std::string _typename, uint32_t lexer_id, std::string value)
@@ -174,7 +355,11 @@ node::NodeIdentIFace* MVCModel::make_ast(TreeContext* tc, std::string filename)
 #ifdef TIXML_USE_TICPP
     ticpp::Document doc(filename.c_str());
     doc.LoadFile();
-    return _make_ast_from_ticpp(tc, &doc);
+    bool hash_cons = tc->hash_cons();
+    tc->set_hash_cons(false); // builds by push_back
+    node::NodeIdentIFace* root = _make_ast_from_ticpp(tc, &doc);
+    tc->set_hash_cons(hash_cons);
+    return root;
 #else
     return NULL;
 #endif
@@ -167,16 +167,16 @@ void exNode
     std::string temp;
     switch(p->type()) {
         case node::NodeIdentIFace::INT:
-            sprintf(word, "%ld", dynamic_cast<const node::TermNodeIFace<node::NodeIdentIFace::INT>*>(p)->value());
+            sprintf(word, "%ld", node::node_cast<node::TermNodeIFace<node::NodeIdentIFace::INT>>(p)->value());
             break;
         case node::NodeIdentIFace::FLOAT:
-            sprintf(word, "%f", dynamic_cast<const node::TermNodeIFace<node::NodeIdentIFace::FLOAT>*>(p)->value());
+            sprintf(word, "%f", node::node_cast<node::TermNodeIFace<node::NodeIdentIFace::FLOAT>>(p)->value());
             break;
         case node::NodeIdentIFace::STRING:
-            sprintf(word, "\"%s\"", dynamic_cast<const node::TermNodeIFace<node::NodeIdentIFace::STRING>*>(p)->value()->c_str());
+            sprintf(word, "\"%s\"", node::node_cast<node::TermNodeIFace<node::NodeIdentIFace::STRING>>(p)->value()->c_str());
             break;
         case typeId:
-            sprintf(word, "%s", dynamic_cast<const node::TermNodeIFace<node::NodeIdentIFace::IDENT>*>(p)->value()->c_str());
+            sprintf(word, "%s", node::node_cast<node::TermNodeIFace<node::NodeIdentIFace::IDENT>>(p)->value()->c_str());
             break;
         case typeOpr:
             temp = p->name();
@@ -194,15 +194,15 @@ void exNode
 
     /* node is term */
     if(p->type() != typeOpr ||
-            dynamic_cast<const node::SymbolNodeIFace*>(p)->size() == 0) {
+            node::node_cast<node::SymbolNodeIFace>(p)->size() == 0) {
         graphDrawBox (s, cbar, l);
         return;
     }
 
     /* node has children */
     cs = c;
-    for(k = 0; k < dynamic_cast<const node::SymbolNodeIFace*>(p)->size(); k++) {
-        exNode (dynamic_cast<const node::SymbolNodeIFace*>(p)->operator[](k), cs, l+h+eps, &che, &chm);
+    for(k = 0; k < node::node_cast<node::SymbolNodeIFace>(p)->size(); k++) {
+        exNode (node::node_cast<node::SymbolNodeIFace>(p)->operator[](k), cs, l+h+eps, &che, &chm);
         cs = che;
     }
 
@@ -218,8 +218,8 @@ void exNode
 
     /* draw arrows (not optimal: children are drawn a second time) */
     cs = c;
-    for(k = 0; k < dynamic_cast<const node::SymbolNodeIFace*>(p)->size(); k++) {
-        exNode (dynamic_cast<const node::SymbolNodeIFace*>(p)->operator[](k), cs, l+h+eps, &che, &chm);
+    for(k = 0; k < node::node_cast<node::SymbolNodeIFace>(p)->size(); k++) {
+        exNode (node::node_cast<node::SymbolNodeIFace>(p)->operator[](k), cs, l+h+eps, &che, &chm);
         graphDrawArrow (*cm, l+h, chm, l+h+eps-1);
         cs = che;
     }
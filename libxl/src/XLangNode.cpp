@@ -25,6 +25,12 @@
 // prototype
 extern std::string id_to_name(uint32_t lexer_id);
 
+// lowest set bit, the span of a Fenwick tree node
+static size_t lowest_bit(size_t i)
+{
+    return i & (~i+1);
+}
+
 static std::string ptr_to_string(const void* x)
 {
     std::stringstream ss;
@@ -49,33 +55,35 @@ void Node::detach()
 {
     if(!m_parent)
         return;
-    xl::node::SymbolNodeIFace* parent_symbol =
-            dynamic_cast<xl::node::SymbolNodeIFace*>(m_parent);
-    if(parent_symbol)
-        parent_symbol->remove_first(this);
+    if(m_parent->type() == NodeIdentIFace::SYMBOL)
+        node_cast<SymbolNodeIFace>(m_parent)->remove_first(this);
+}
+
+// Clears the cached hashes up to the first ancestor without one. Every ancestor of a node
+// without a hash has none either, since computing a hash computes the children's first.
+void Node::invalidate_hash()
+{
+    if(!m_hash)
+        return;
+    m_hash = 0;
+    if(m_parent)
+        m_parent->invalidate_hash();
 }
 
 int Node::index() const
 {
     if(!m_parent)
         return -1;
-    xl::node::SymbolNodeIFace* parent_symbol =
-            dynamic_cast<xl::node::SymbolNodeIFace*>(m_parent);
-    if(!parent_symbol)
+    if(m_parent->type() != NodeIdentIFace::SYMBOL)
         return -1;
-    for(size_t i = 0; i<parent_symbol->size(); i++)
-    {
-        if((*parent_symbol)[i] == this)
-            return i;
-    }
-    return -1;
+    return node_cast<SymbolNodeIFace>(m_parent)->index_of(this);
 }
 
 template<>
 NodeIdentIFace* TermNode<NodeIdentIFace::STRING>::clone(TreeContext* tc) const
 {
-    TermNodeIFace<NodeIdentIFace::STRING> *_clone = new (PNEW(tc->alloc(), , NodeIdentIFace))
-            TermNode<NodeIdentIFace::STRING>(m_lexer_id, m_value);
+    TermNodeIFace<NodeIdentIFace::STRING> *_clone = new (PNEW_LOC(tc->alloc()))
+            TermNode<NodeIdentIFace::STRING>(m_lexer_id, m_value); // assumes trivial dtor
     _clone->set_original(this);
     return _clone;
 }
@@ -83,14 +91,18 @@ NodeIdentIFace* TermNode<NodeIdentIFace::STRING>::clone(TreeContext* tc) const
 template<>
 bool TermNode<NodeIdentIFace::STRING>::compare(const NodeIdentIFace* _node) const
 {
+    if(_node == this)
+        return true;
     if(!is_same_type(_node))
         return false;
-    return *m_value == *dynamic_cast<const TermNode<NodeIdentIFace::STRING>*>(_node)->value();
+    return *m_value == *node_cast<TermNodeIFace<NodeIdentIFace::STRING>>(_node)->value();
 }
 
-SymbolNode::SymbolNode(uint32_t _lexer_id, size_t _size, va_list ap)
-    : Node(NodeIdentIFace::SYMBOL, _lexer_id)
+SymbolNode::SymbolNode(TreeContext* tc, uint32_t _lexer_id, size_t _size, va_list ap)
+    : Node(NodeIdentIFace::SYMBOL, _lexer_id), m_child_vec(tc->alloc()), m_hole_count(0), m_first_hole(0),
+      m_hole_tree_size(0), m_hole_tree(NULL), m_lazy_tc(NULL)
 {
+    m_child_vec.reserve(_size);
     for(size_t i = 0; i<_size; i++)
     {
         NodeIdentIFace* child = va_arg(ap, NodeIdentIFace*);
@@ -98,26 +110,21 @@ SymbolNode::SymbolNode(uint32_t _lexer_id, size_t _size, va_list ap)
             continue;
         if(child && is_same_type(child))
         {
-            SymbolNode* child_symbol = dynamic_cast<SymbolNode*>(child);
-            m_child_vec.insert(m_child_vec.end(),
-                    child_symbol->m_child_vec.begin(),
-                    child_symbol->m_child_vec.end());
+            SymbolNode* child_symbol = static_cast<SymbolNode*>(node_cast<SymbolNodeIFace>(child));
+            child_symbol->_unshare();
             for(auto p = child_symbol->m_child_vec.begin(); p != child_symbol->m_child_vec.end(); ++p)
-            {
-                if(*p)
-                    (*p)->set_parent(this);
-            }
+                _adopt(*p, tc->hash_cons()); // an interned child_symbol keeps its children
             continue;
         }
-        m_child_vec.push_back(child);
-        if(child)
-            child->set_parent(this);
+        _adopt(child, tc->hash_cons());
     }
 }
 
-SymbolNode::SymbolNode(uint32_t _lexer_id, std::vector<NodeIdentIFace*>& vec)
-    : Node(NodeIdentIFace::SYMBOL, _lexer_id)
+SymbolNode::SymbolNode(TreeContext* tc, uint32_t _lexer_id, std::vector<NodeIdentIFace*>& vec)
+    : Node(NodeIdentIFace::SYMBOL, _lexer_id), m_child_vec(tc->alloc()), m_hole_count(0), m_first_hole(0),
+      m_hole_tree_size(0), m_hole_tree(NULL), m_lazy_tc(NULL)
 {
+    m_child_vec.reserve(vec.size());
     for(auto q = vec.begin(); q != vec.end(); q++)
     {
         NodeIdentIFace* child = *q;
@@ -125,29 +132,42 @@ SymbolNode::SymbolNode(uint32_t _lexer_id, std::vector<NodeIdentIFace*>& vec)
             continue;
         if(child && is_same_type(child))
         {
-            SymbolNode* child_symbol = dynamic_cast<SymbolNode*>(child);
-            m_child_vec.insert(m_child_vec.end(),
-                    child_symbol->m_child_vec.begin(),
-                    child_symbol->m_child_vec.end());
+            SymbolNode* child_symbol = static_cast<SymbolNode*>(node_cast<SymbolNodeIFace>(child));
+            child_symbol->_unshare();
             for(auto p = child_symbol->m_child_vec.begin(); p != child_symbol->m_child_vec.end(); ++p)
-            {
-                if(*p)
-                    (*p)->set_parent(this);
-            }
+                _adopt(*p, tc->hash_cons()); // an interned child_symbol keeps its children
             continue;
         }
-        m_child_vec.push_back(child);
-        if(child)
-            child->set_parent(this);
+        _adopt(child, tc->hash_cons());
     }
 }
 
+SymbolNode::~SymbolNode()
+{
+    if(m_hole_tree)
+        m_child_vec.allocator()._free(m_hole_tree);
+}
+
+// With TreeContext::lazy_clone(), the clone copies nothing until it is changed. Reads are served
+// from the original, so the nodes they return are the original's. A mutator or edit() gives the
+// clone its own children first, as lazy clones in turn, so reaching a node to change through
+// edit() copies only the path down to it. The original must not change while a lazy clone of
+// it is in use.
 NodeIdentIFace* SymbolNode::clone(TreeContext* tc) const
 {
     va_list ap;
-    SymbolNodeIFace *_clone = new (PNEW(tc->alloc(), , NodeIdentIFace))
-            SymbolNode(m_lexer_id, 0, ap);
+    SymbolNode *_clone = new (PNEW(tc->alloc(), , NodeIdentIFace))
+            SymbolNode(tc, m_lexer_id, 0, ap);
+    if(tc->lazy_clone())
+    {
+        _clone->set_original(m_lazy_tc ? m_original : this);
+        _clone->m_lazy_tc = tc;
+        return _clone;
+    }
+    if(m_lazy_tc)
+        return m_original->clone(tc);
     _clone->set_original(this);
+    _sync();
     for(auto p = m_child_vec.begin(); p != m_child_vec.end(); ++p)
     {
         NodeIdentIFace *child_clone = (*p) ? (*p)->clone(tc) : NULL;
@@ -158,68 +178,121 @@ NodeIdentIFace* SymbolNode::clone(TreeContext* tc) const
     return _clone;
 }
 
+// keeps the holes, a child appended after them is ranked like the rest
 void SymbolNode::push_back(NodeIdentIFace* _node)
 {
-    m_child_vec.push_back(_node);
-    if(_node)
-        _node->set_parent(this);
+    invalidate_hash();
+    if(m_lazy_tc)
+        _materialize();
+    _adopt(_node);
+    if(m_hole_tree_size)
+        _grow_hole_tree();
 }
 
 void SymbolNode::push_front(NodeIdentIFace* _node)
 {
+    invalidate_hash();
+    _unshare();
     m_child_vec.insert(m_child_vec.begin(), _node);
     if(_node)
         _node->set_parent(this);
+    _renumber(0);
 }
 
 void SymbolNode::insert_after(NodeIdentIFace* insert_after_node, NodeIdentIFace* new_node)
 {
+    invalidate_hash();
+    if(m_lazy_tc)
+        insert_after_node = _materialize(insert_after_node);
+    _sync();
     auto p = std::find(m_child_vec.begin(), m_child_vec.end(), insert_after_node);
     if(p == m_child_vec.end())
         return;
     p++;
+    size_t index = p-m_child_vec.begin();
     m_child_vec.insert(p, new_node);
     new_node->set_parent(this);
+    _renumber(index);
 }
 
+// constant time for a child that knows its slot
 void SymbolNode::remove_first(NodeIdentIFace* _node)
 {
+    invalidate_hash();
+    if(m_lazy_tc)
+        _node = _materialize(_node);
+    if(_node && _node->parent() == this)
+    {
+        int slot = _node->slot();
+        if(slot >= 0 && slot < static_cast<int>(m_child_vec.size()) && m_child_vec[slot] == _node)
+        {
+            _make_hole(slot);
+            return;
+        }
+    }
+    _sync();
     auto p = std::find(m_child_vec.begin(), m_child_vec.end(), _node);
     if(p == m_child_vec.end())
         return;
+    size_t index = p-m_child_vec.begin();
     m_child_vec.erase(std::remove(p, m_child_vec.end(), _node), m_child_vec.end());
-    if(_node)
+    if(_node && _node->parent() == this)
+    {
         _node->set_parent(NULL);
+        _node->set_slot(-1);
+    }
+    _renumber(index);
 }
 
 void SymbolNode::replace_first(NodeIdentIFace* find_node, NodeIdentIFace* replacement_node)
 {
+    invalidate_hash();
+    if(m_lazy_tc)
+        find_node = _materialize(find_node);
+    _sync();
     auto p = std::find(m_child_vec.begin(), m_child_vec.end(), find_node);
     if(p == m_child_vec.end())
         return;
+    size_t index = p-m_child_vec.begin();
     std::replace(p, m_child_vec.end(), find_node, replacement_node);
-    if(find_node)
+    if(find_node && find_node->parent() == this)
+    {
         find_node->set_parent(NULL);
+        find_node->set_slot(-1);
+    }
     if(replacement_node)
+    {
         replacement_node->set_parent(this);
+        replacement_node->set_slot(index);
+    }
 }
 
 void SymbolNode::erase(int index)
 {
-    if(index<0 || index >= static_cast<int>(m_child_vec.size()))
+    invalidate_hash();
+    if(m_lazy_tc)
+        _materialize();
+    _sync_ranked();
+    if(index<0 || index >= static_cast<int>(size()))
         return;
-    auto p = m_child_vec.begin()+index;
-    if(p == m_child_vec.end())
-        return;
-    if(*p)
-        (*p)->set_parent(NULL);
-    m_child_vec.erase(p);
+    _make_hole(_slot_of(index));
+}
+
+// keeps the hash, a change to the child clears it through the parent links
+NodeIdentIFace* SymbolNode::edit(uint32_t index)
+{
+    if(m_lazy_tc)
+        _materialize();
+    return (*this)[index];
 }
 
 NodeIdentIFace* SymbolNode::find_if(bool (*pred)(const NodeIdentIFace* _node)) const
 {
     if(!pred)
         return NULL;
+    if(m_lazy_tc)
+        return _source()->find_if(pred);
+    _sync();
     auto p = std::find_if(m_child_vec.begin(), m_child_vec.end(), pred);
     if(p == m_child_vec.end())
         return NULL;
@@ -227,4 +300,176 @@ NodeIdentIFace* SymbolNode::find_if(bool (*pred)(const NodeIdentIFace* _node)) c
     return m_child_vec[index];
 }
 
+int SymbolNode::index_of(const NodeIdentIFace* _node) const
+{
+    if(m_lazy_tc)
+        return _source()->index_of(_node);
+    _sync_ranked();
+    if(_node && _node->parent() == this)
+    {
+        int slot = _node->slot();
+        if(slot >= 0 && slot < static_cast<int>(m_child_vec.size()) && m_child_vec[slot] == _node)
+            return _index_of_slot(slot);
+    }
+    auto p = std::find(m_child_vec.begin(), m_child_vec.end(), _node);
+    if(p == m_child_vec.end())
+        return -1;
+    return _index_of_slot(p-m_child_vec.begin());
+}
+
+// Leaves the cached hash, the children are equal to original()'s. A hashed node must not have
+// unhashed children, or invalidate_hash would stop short of it, so the child clones get theirs.
+void SymbolNode::_materialize()
+{
+    auto source = _source();
+    TreeContext* tc = m_lazy_tc;
+    m_lazy_tc = NULL;
+    m_child_vec.reserve(source->size());
+    for(size_t i = 0; i < source->size(); i++)
+    {
+        const NodeIdentIFace* child = (*source)[i];
+        NodeIdentIFace* child_clone = child ? child->clone(tc) : NULL;
+        if(m_hash && child_clone)
+            child_clone->hash();
+        _adopt(child_clone);
+    }
+}
+
+// same, and returns the copy of _node, a child read through this before
+NodeIdentIFace* SymbolNode::_materialize(NodeIdentIFace* _node)
+{
+    int index = _source()->index_of(_node);
+    _materialize();
+    return (index<0) ? _node : m_child_vec[index];
+}
+
+void SymbolNode::_remove_holes() const
+{
+    size_t w = m_first_hole;
+    for(size_t r = m_first_hole; r < m_child_vec.size(); r++)
+    {
+        NodeIdentIFace* child = m_child_vec[r];
+        if(child == hole())
+            continue;
+        m_child_vec[w] = child;
+        if(child && child->parent() == this)
+            child->set_slot(w);
+        w++;
+    }
+    m_child_vec.erase(m_child_vec.begin()+w, m_child_vec.end());
+    m_hole_count = 0;
+    m_hole_tree_size = 0;
+}
+
+void SymbolNode::_build_hole_tree() const
+{
+    size_t n = m_child_vec.size();
+    Allocator &alloc = m_child_vec.allocator();
+    if(!m_hole_tree || alloc.capacity(m_hole_tree) < sizeof(uint32_t)*(n+1))
+    {
+        if(m_hole_tree)
+            alloc._free(m_hole_tree);
+        m_hole_tree = PNEW_ARRAY(alloc, uint32_t, 2*n+1); // room for push_back to grow it
+    }
+    m_hole_tree[0] = 0;
+    for(size_t i = 1; i <= n; i++)
+        m_hole_tree[i] = (m_child_vec[i-1] == hole());
+    for(size_t i = 1; i <= n; i++)
+    {
+        size_t j = i+lowest_bit(i);
+        if(j <= n)
+            m_hole_tree[j] += m_hole_tree[i];
+    }
+    m_hole_tree_size = n;
+}
+
+// the slot of the child at index, past the first hole
+size_t SymbolNode::_select_slot(size_t index) const
+{
+    if(!m_hole_tree_size)
+        _build_hole_tree();
+    size_t n = m_hole_tree_size;
+    size_t step = 1;
+    while(step*2 <= n)
+        step *= 2;
+    size_t slot = 0;
+    size_t remaining = index+1; // children still to pass
+    for(; step; step /= 2)
+    {
+        if(slot+step > n)
+            continue;
+        size_t child_count = step-m_hole_tree[slot+step];
+        if(child_count < remaining)
+        {
+            slot += step;
+            remaining -= child_count;
+        }
+    }
+    return slot;
+}
+
+size_t SymbolNode::_holes_before(size_t slot) const
+{
+    if(!m_hole_tree_size)
+        _build_hole_tree();
+    size_t hole_count = 0;
+    for(size_t i = slot; i; i -= lowest_bit(i))
+        hole_count += m_hole_tree[i];
+    return hole_count;
+}
+
+// takes in the last slot, just appended, or leaves the tree to be rebuilt if it has no room
+void SymbolNode::_grow_hole_tree() const
+{
+    size_t n = m_child_vec.size();
+    if(m_child_vec.allocator().capacity(m_hole_tree) < sizeof(uint32_t)*(n+1))
+    {
+        m_hole_tree_size = 0;
+        return;
+    }
+    m_hole_tree[n] = _holes_before(n-1)-_holes_before(n-lowest_bit(n));
+    m_hole_tree_size = n;
+}
+
+void SymbolNode::_renumber(size_t from) const
+{
+    for(size_t i = from; i < m_child_vec.size(); i++)
+    {
+        if(m_child_vec[i] && m_child_vec[i]->parent() == this)
+            m_child_vec[i]->set_slot(i);
+    }
+}
+
+// A hash-consed child that already has a parent keeps it, and is marked shared. Its parent and
+// slot belong to that parent, so only children whose parent() is this get them updated here.
+void SymbolNode::_adopt(NodeIdentIFace* child, bool hash_cons)
+{
+    m_child_vec.push_back(child);
+    if(!child)
+        return;
+    if(hash_cons && child->parent() && child->parent() != this)
+    {
+        child->set_shared(true);
+        return;
+    }
+    child->set_parent(this);
+    child->set_slot(m_child_vec.size()-1);
+}
+
+void SymbolNode::_make_hole(size_t slot)
+{
+    NodeIdentIFace* child = m_child_vec[slot];
+    m_child_vec[slot] = hole();
+    if(!m_hole_count || slot < m_first_hole)
+        m_first_hole = slot;
+    m_hole_count++;
+    for(size_t i = slot+1; i <= m_hole_tree_size; i += lowest_bit(i))
+        m_hole_tree[i]++;
+    if(child && child->parent() == this)
+    {
+        child->set_parent(NULL);
+        child->set_slot(-1);
+    }
+}
+
 } }
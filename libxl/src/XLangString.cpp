@@ -19,7 +19,7 @@
 #include <iostream> // std::cerr
 #include <string> // std::string
 #include <sstream> // std::stringstream
-#include <string.h> // strcpy
+#include <string.h> // strlen
 #include <vector> // std::vector
 #include <regex.h> // regex_t
 #include <stdarg.h> // va_list
@@ -42,17 +42,10 @@ bool read_file(std::string filename, std::string &s)
         fclose(file);
         return false;
     }
-    char* buffer = new char[length+1];
-    if(!buffer) {
-        std::cerr << "not enough memory" << std::endl;
-        fclose(file);
-        return false;
-    }
-    buffer[length] = '\0';
-    fread(buffer, 1, length, file);
+    s.resize(length); // read in place, no scratch buffer
+    s.resize(fread(&s[0], 1, length, file));
     fclose(file);
-    s = buffer;
-    delete[] buffer;
+    s.resize(strlen(s.c_str())); // stop at an embedded NUL, like the c-string copy used to
     return true;
 }
 
@@ -85,7 +78,7 @@ std::vector<std::string> tokenize(const std::string &s, const char* delim)
     return results;
 }
 
-std::string escape_xml(std::string &s)
+std::string escape_xml(const std::string &s)
 {
     std::string _s(s);
     _s = replace(_s, "&",  "&amp;"); // must replace first
@@ -96,7 +89,7 @@ std::string escape_xml(std::string &s)
     return escape(_s);
 }
 
-std::string unescape_xml(std::string &s)
+std::string unescape_xml(const std::string &s)
 {
     std::string _s(s);
     _s = replace(_s, "&quot;", "\"");
@@ -107,7 +100,7 @@ std::string unescape_xml(std::string &s)
     return unescape(_s);
 }
 
-std::string escape(std::string &s)
+std::string escape(const std::string &s)
 {
     std::stringstream ss;
     for(size_t i = 0; i<s.length(); i++) {
@@ -116,13 +109,12 @@ std::string escape(std::string &s)
     return ss.str();
 }
 
-std::string unescape(std::string &s)
+std::string unescape(const std::string &s)
 {
-    char* buf = new char[s.length()+1]; // can't use allocator for arrays
-    strcpy(buf, s.c_str());
-    char* w = buf;
+    std::string s2(s.c_str()); // unescaped in place, it only shrinks
+    char* w = &s2[0];
     bool unescape_next_char = false;
-    for(const char* r = buf; *r; r++) {
+    for(const char* r = s2.c_str(); *r; r++) {
         if(!unescape_next_char && *r == '\\') {
             unescape_next_char = true;
             continue;
@@ -134,9 +126,7 @@ std::string unescape(std::string &s)
         }
         *w++ = *r;
     }
-    *w = '\0';
-    std::string s2(buf);
-    delete []buf;
+    s2.resize(w-s2.c_str());
     return s2;
 }
 
@@ -17,25 +17,146 @@
 
 #include "XLangTreeContext.h" // TreeContext
 #include <string> // std::string
+#include <vector> // std::vector
+#include <mutex> // std::mutex, std::unique_lock
+#include <string.h> // strlen
 
 namespace xl {
 
-std::string* TreeContext::alloc_string(std::string s)
+// One chunk holding the length and the bytes, with no dtor. With dedup_strings, equal
+// literals share one copy in the root arena. That is safe since an InlineString never
+// changes, a rewrite replaces the term with one holding a new string.
+const InlineString* TreeContext::alloc_string(const char* s, size_t n)
 {
-    return new (PNEW_EX(m_alloc, std::, string, basic_string))
-            std::string(s);
+    if(!m_dedup_strings)
+        return InlineString::create(PNEW_ARRAY(alloc(), char, InlineString::alloc_size(n)), s, n);
+    std::unique_lock<std::mutex> lock(m_string_mutex, std::defer_lock);
+    if(m_alloc.concurrent())
+        lock.lock();
+    size_t hash = hash_string(s, n);
+    const InlineString* literal = m_literal_index.find(s, n, hash);
+    if(!literal)
+    {
+        literal = InlineString::create(PNEW_ARRAY(m_alloc, char, InlineString::alloc_size(n)), s, n);
+        m_literal_index.insert(literal, hash);
+        m_literal_vec.push_back(literal);
+    }
+    return literal;
+}
+
+// Hashes once, and only copies the bytes when they are new.
+const std::string* TreeContext::alloc_unique_string(const char* s, size_t n)
+{
+    size_t hash = hash_string(s, n);
+    if(m_pool)
+    {
+        const std::string* shared_string = m_pool->find(s, n, hash, m_intern_table.base_id());
+        if(shared_string)
+            return shared_string;
+    }
+    std::unique_lock<std::mutex> lock(m_string_mutex, std::defer_lock);
+    if(m_alloc.concurrent())
+        lock.lock();
+    const std::string* unique_string = m_intern_table.find(s, n, hash);
+    if(!unique_string)
+        unique_string = m_intern_table.insert(s, n, hash);
+    return unique_string;
+}
+
+const std::string* TreeContext::alloc_unique_string(const char* s)
+{
+    return alloc_unique_string(s, strlen(s));
+}
+
+// Copies the strings this parse interned into the pool, so later parses share them. Atom
+// ids already handed out by this context are unchanged.
+void TreeContext::publish_strings()
+{
+    if(!m_pool)
+        return;
+    for(size_t i = 0; i < m_intern_table.size(); i++)
+        m_pool->alloc_unique_string(m_intern_table[i]->data(), m_intern_table[i]->size());
+}
+
+TreeContext::mark_t TreeContext::mark()
+{
+    mark_t _mark = {alloc().mark(), m_arena_stack.size(), m_intern_table.size(), m_literal_vec.size(),
+            m_node_vec.size(), m_root};
+    return _mark;
+}
+
+// releases every node and string allocated since _mark, including unique strings
+void TreeContext::rollback(mark_t _mark)
+{
+    m_intern_table.trim(_mark.m_string_count);
+    while(m_literal_vec.size() > _mark.m_literal_count)
+    {
+        const InlineString* literal = m_literal_vec.back();
+        m_literal_index.erase(literal, hash_string(literal->data(), literal->size()));
+        m_literal_vec.pop_back();
+    }
+    _trim_nodes(_mark.m_node_count);
+    m_arena_stack.resize(_mark.m_arena_count); // child arenas pushed since are released by the rollback
+    m_arena_node_count.resize(_mark.m_arena_count);
+    alloc().rollback(_mark.m_alloc_mark);
+    m_root = _mark.m_root;
+}
+
+void TreeContext::commit(mark_t _mark)
+{
+    m_arena_stack.resize(_mark.m_arena_count);
+    m_arena_node_count.resize(_mark.m_arena_count);
+    alloc().commit(_mark.m_alloc_mark);
+}
+
+// Nodes are allocated in a child arena until the matching pop_arena. Unique strings
+// still go to the root arena, since later subtrees may share them.
+void TreeContext::push_arena()
+{
+    Allocator &parent = alloc();
+    m_arena_stack.push_back(new (PNEW(parent, xl::, Allocator)) Allocator(parent.name(), parent));
+    m_arena_node_count.push_back(m_node_vec.size());
+}
+
+// Releases everything allocated since the matching push_arena, unless it is kept. A kept
+// arena lives as long as the arena it was pushed from.
+void TreeContext::pop_arena(bool keep)
+{
+    if(m_arena_stack.empty())
+        return;
+    Allocator* child = m_arena_stack.back();
+    m_arena_stack.pop_back();
+    size_t node_count = m_arena_node_count.back();
+    m_arena_node_count.pop_back();
+    if(!keep)
+    {
+        _trim_nodes(node_count);
+        alloc()._free(child);
+    }
+}
+
+void TreeContext::insert_node(size_t hash, node::NodeIdentIFace* _node)
+{
+    m_node_index.insert(std::make_pair(hash, _node));
+    m_node_vec.push_back(std::make_pair(hash, _node));
 }
 
-const std::string* TreeContext::alloc_unique_string(std::string name)
+// forgets the hash-consed nodes made after the first count, before their memory is released
+void TreeContext::_trim_nodes(size_t count)
 {
-    auto p = m_string_set.find(&name);
-    if(p == m_string_set.end())
+    while(m_node_vec.size() > count)
     {
-        m_string_set.insert(new (PNEW_EX(m_alloc, std::, string, basic_string))
-                std::string(name));
-        p = m_string_set.find(&name);
+        auto range = m_node_index.equal_range(m_node_vec.back().first);
+        for(auto p = range.first; p != range.second; ++p)
+        {
+            if(p->second == m_node_vec.back().second)
+            {
+                m_node_index.erase(p);
+                break;
+            }
+        }
+        m_node_vec.pop_back();
     }
-    return *p;
 }
 
 }
@@ -66,22 +66,22 @@ void Visitor::dispatch_visit(const node::NodeIdentIFace* unknown)
     switch(unknown->type())
     {
         case node::NodeIdentIFace::INT:
-            visit(dynamic_cast<const node::TermNodeIFace<node::NodeIdentIFace::INT>*>(unknown));
+            visit(node::node_cast<node::TermNodeIFace<node::NodeIdentIFace::INT>>(unknown));
             break;
         case node::NodeIdentIFace::FLOAT:
-            visit(dynamic_cast<const node::TermNodeIFace<node::NodeIdentIFace::FLOAT>*>(unknown));
+            visit(node::node_cast<node::TermNodeIFace<node::NodeIdentIFace::FLOAT>>(unknown));
             break;
         case node::NodeIdentIFace::STRING:
-            visit(dynamic_cast<const node::TermNodeIFace<node::NodeIdentIFace::STRING>*>(unknown));
+            visit(node::node_cast<node::TermNodeIFace<node::NodeIdentIFace::STRING>>(unknown));
             break;
         case node::NodeIdentIFace::CHAR:
-            visit(dynamic_cast<const node::TermNodeIFace<node::NodeIdentIFace::CHAR>*>(unknown));
+            visit(node::node_cast<node::TermNodeIFace<node::NodeIdentIFace::CHAR>>(unknown));
             break;
         case node::NodeIdentIFace::IDENT:
-            visit(dynamic_cast<const node::TermNodeIFace<node::NodeIdentIFace::IDENT>*>(unknown));
+            visit(node::node_cast<node::TermNodeIFace<node::NodeIdentIFace::IDENT>>(unknown));
             break;
         case node::NodeIdentIFace::SYMBOL:
-            visit(dynamic_cast<const node::SymbolNodeIFace*>(unknown));
+            visit(node::node_cast<node::SymbolNodeIFace>(unknown));
             break;
         default:
             std::cout << "unknown node type" << std::endl;
@@ -100,7 +100,7 @@ void VisitorDFS::visit(const node::SymbolNodeIFace* _node)
             {
                 if(m_filter_cb(child) && child->type() == node::NodeIdentIFace::SYMBOL)
                 {
-                    VisitorDFS::visit(dynamic_cast<const node::SymbolNodeIFace*>(child));
+                    VisitorDFS::visit(node::node_cast<node::SymbolNodeIFace>(child));
                     continue;
                 }
                 dispatch_visit(child);
@@ -165,7 +165,7 @@ bool VisitorBFS::next_state()
         _node = visit_state.front();
         if(_node && _node->type() == node::NodeIdentIFace::SYMBOL)
         {
-            auto symbol = dynamic_cast<const node::SymbolNodeIFace*>(_node);
+            auto symbol = node::node_cast<node::SymbolNodeIFace>(_node);
             for(int i = 0; i<static_cast<int>(symbol->size()); i++)
                 visit_state.push((*symbol)[i]);
         }
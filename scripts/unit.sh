@@ -0,0 +1,52 @@
+#!/bin/bash
+
+# XLang
+# -- A parser framework for language modeling
+# Copyright (C) 2011 onlyuser <mailto:onlyuser@gmail.com>
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+show_help()
+{
+    echo "Usage: `basename $0` <EXEC> <OUTPUT_FILE_STEM>"
+}
+
+if [ $# -ne 2 ]; then
+    echo "fail! -- expect 2 arguments! ==> $@"
+    show_help
+    exit 1
+fi
+
+TEMP_FILE=`mktemp`
+trap "rm $TEMP_FILE" EXIT
+
+EXEC=$1
+OUTPUT_FILE_STEM=$2
+PASS_FILE=${OUTPUT_FILE_STEM}.pass
+FAIL_FILE=${OUTPUT_FILE_STEM}.fail
+
+if [ ! -f $EXEC ]; then
+    echo "fail! -- EXEC not found! ==> $EXEC"
+    exit 1
+fi
+
+$EXEC > $TEMP_FILE 2>&1
+if [ $? -ne 0 ]; then
+    cat $TEMP_FILE
+    echo "fail!"
+    cp $TEMP_FILE $FAIL_FILE # TEMP_FILE already trapped on exit!
+    exit 1
+fi
+
+echo "success!" | tee $PASS_FILE
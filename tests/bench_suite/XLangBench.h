@@ -0,0 +1,54 @@
+// XLang
+// -- A parser framework for language modeling
+// Copyright (C) 2011 onlyuser <mailto:onlyuser@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef XLANG_BENCH_H_
+#define XLANG_BENCH_H_
+
+#include "XLangType.h" // uint32_t
+#include <string> // std::string
+#include <chrono> // std::chrono
+#include <stdlib.h> // atoi
+
+// node names are up to the client of libxl
+std::string id_to_name(uint32_t lexer_id)
+{
+    return "id_" + std::to_string(lexer_id);
+}
+
+// best of several runs, so one slow run (page faults, a busy core) doesn't skew the result
+template<class F>
+double best_ms(int run_count, F f)
+{
+    double best = 0;
+    for(int i = 0; i < run_count; i++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        f();
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now()-start).count();
+        if(!i || ms < best)
+            best = ms;
+    }
+    return best;
+}
+
+// the first argument scales the workload, so a quick run and a long one use the same program
+size_t scale_arg(int argc, char** argv, size_t default_scale)
+{
+    return (argc > 1 && atoi(argv[1]) > 0) ? atoi(argv[1]) : default_scale;
+}
+
+#endif
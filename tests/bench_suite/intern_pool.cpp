@@ -0,0 +1,98 @@
+// XLang
+// -- A parser framework for language modeling
+// Copyright (C) 2011 onlyuser <mailto:onlyuser@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#include "XLangBench.h" // best_ms, scale_arg
+#include "XLangInternTable.h" // InternPool
+#include <set> // std::set
+#include <string> // std::string
+#include <vector> // std::vector
+#include <thread> // std::thread
+#include <mutex> // std::mutex
+#include <random> // std::mt19937
+#include <stdio.h> // printf
+
+// Interns an identifier-heavy token stream from 1 to 64 threads at once, into one
+// InternPool, and into a std::set behind a mutex for comparison. Every thread interns the
+// same number of tokens, so a table that scales keeps its per-thread rate as threads are
+// added. The argument is the number of tokens per thread, in thousands.
+
+static const size_t VOCABULARY_SIZE = 64*1024;
+static const int    MAX_THREAD_COUNT = 64;
+
+// mostly a few hot names, as in source code, with a long tail
+static std::vector<std::string> make_tokens(size_t token_count, unsigned seed)
+{
+    std::mt19937 rng(seed);
+    std::vector<std::string> token_vec;
+    for(size_t i = 0; i < token_count; i++)
+    {
+        size_t rank = (rng()%4) ? rng()%256 : rng()%VOCABULARY_SIZE;
+        token_vec.push_back("ident_" + std::to_string(rank));
+    }
+    return token_vec;
+}
+
+class LockedSet
+{
+public:
+    const std::string* alloc_unique_string(const char* s, size_t n)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return &*m_set.insert(std::string(s, n)).first;
+    }
+
+private:
+    std::set<std::string> m_set;
+    std::mutex            m_mutex;
+};
+
+template<class T>
+static double run(int thread_count, const std::vector<std::vector<std::string>> &token_vecs)
+{
+    return best_ms(3, [&]() {
+            T table;
+            std::vector<std::thread> thread_vec;
+            for(int i = 0; i < thread_count; i++)
+            {
+                const std::vector<std::string> &token_vec = token_vecs[i];
+                thread_vec.push_back(std::thread([&table, &token_vec]() {
+                        for(auto p = token_vec.begin(); p != token_vec.end(); ++p)
+                            table.alloc_unique_string((*p).data(), (*p).size());
+                    }));
+            }
+            for(auto q = thread_vec.begin(); q != thread_vec.end(); ++q)
+                (*q).join();
+        });
+}
+
+int main(int argc, char** argv)
+{
+    size_t token_count = scale_arg(argc, argv, 256)*1024;
+    std::vector<std::vector<std::string>> token_vecs;
+    for(int i = 0; i < MAX_THREAD_COUNT; i++)
+        token_vecs.push_back(make_tokens(token_count, i));
+    printf("%zu tokens per thread, %u hardware threads\n", token_count, std::thread::hardware_concurrency());
+    printf("%8s %28s %28s\n", "threads", "InternPool M tokens/s", "locked std::set M tokens/s");
+    for(int thread_count = 1; thread_count <= MAX_THREAD_COUNT; thread_count *= 2)
+    {
+        double pool_ms = run<xl::InternPool>(thread_count, token_vecs);
+        double set_ms  = run<LockedSet>(thread_count, token_vecs);
+        printf("%8d %28.1f %28.1f\n", thread_count,
+                thread_count*token_count/pool_ms/1000, thread_count*token_count/set_ms/1000);
+    }
+    return 0;
+}
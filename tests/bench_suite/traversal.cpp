@@ -0,0 +1,118 @@
+// XLang
+// -- A parser framework for language modeling
+// Copyright (C) 2011 onlyuser <mailto:onlyuser@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#include "XLangBench.h" // best_ms, scale_arg
+#include "XLangAlloc.h" // Allocator
+#include "XLangTreeContext.h" // TreeContext
+#include "mvc/XLangMVCModel.h" // mvc::MVCModel
+#include "node/XLangNodeIFace.h" // node::NodeIdentIFace
+#include "visitor/XLangVisitor.h" // visitor::VisitorDFS
+#include <vector> // std::vector
+#include <stdio.h> // printf
+
+// Compares VisitorDFS throughput over the same tree built by each block source, and by the
+// malloc-backed MODE_TRACKING. The argument is the number of terms, in thousands.
+
+class CountingVisitor : public xl::visitor::VisitorDFS
+{
+public:
+    CountingVisitor() : m_count(0)
+    {}
+    using xl::visitor::VisitorDFS::visit;
+    void visit(const xl::node::TermNodeIFace<xl::node::NodeIdentIFace::INT>* _node)
+    {
+        m_count += (_node->value() >= 0); // reads the term, as a real pass would
+    }
+    void visit(const xl::node::SymbolNodeIFace* _node)
+    {
+        m_count++;
+        xl::visitor::VisitorDFS::visit(_node);
+    }
+    bool is_printer() const { return false; }
+    size_t count() const { return m_count; }
+
+private:
+    size_t m_count;
+};
+
+// bottom-up, in the order a parser reduces, so terms and symbols are interleaved
+static xl::node::NodeIdentIFace* build_tree(xl::TreeContext* tc, size_t term_count)
+{
+    std::vector<xl::node::NodeIdentIFace*> level;
+    for(size_t i = 0; i < term_count; i += 4)
+    {
+        level.push_back(xl::mvc::MVCModel::make_symbol(tc, 1, 4,
+                xl::mvc::MVCModel::make_term(tc, 2, static_cast<long>(i)),
+                xl::mvc::MVCModel::make_term(tc, 2, static_cast<long>(i+1)),
+                xl::mvc::MVCModel::make_term(tc, 2, static_cast<long>(i+2)),
+                xl::mvc::MVCModel::make_term(tc, 2, static_cast<long>(i+3))));
+    }
+    while(level.size() > 1)
+    {
+        std::vector<xl::node::NodeIdentIFace*> next_level;
+        for(size_t i = 0; i+1 < level.size(); i += 2)
+            next_level.push_back(xl::mvc::MVCModel::make_symbol(tc, 3, 2, level[i], level[i+1]));
+        if(level.size()%2)
+            next_level.push_back(level.back());
+        level.swap(next_level);
+    }
+    return level.empty() ? NULL : level[0];
+}
+
+static void run(const char* name, xl::Allocator::mode_e mode, xl::Allocator::block_source_e block_source,
+        size_t block_size_bytes, bool prefault, size_t term_count)
+{
+    static const int RUN_COUNT = 5;
+    xl::Allocator alloc(name, mode);
+    if(mode == xl::Allocator::MODE_ARENA && !alloc.set_block_source(block_source, block_size_bytes, prefault))
+    {
+        printf("%-26s .. block source not available\n", name);
+        return;
+    }
+    xl::TreeContext tc(alloc);
+    xl::node::NodeIdentIFace* root = NULL;
+    double build_ms = best_ms(1, [&]() { root = build_tree(&tc, term_count); });
+    size_t node_count = 0;
+    double visit_ms = best_ms(RUN_COUNT, [&]() {
+            CountingVisitor v;
+            v.dispatch_visit(root);
+            node_count = v.count();
+        });
+    printf("%-26s .. build %8.1f ms, traverse %8.1f ms, %6.1f M nodes/s\n",
+            name, build_ms, visit_ms, node_count/visit_ms/1000);
+}
+
+int main(int argc, char** argv)
+{
+    size_t term_count = scale_arg(argc, argv, 1024)*1024;
+    printf("%zu terms\n", term_count);
+#ifdef XLANG_NO_ALLOC_TRACKING
+    printf("%-26s .. compiled out by XLANG_NO_ALLOC_TRACKING\n", "tracking (malloc)");
+#else
+    run("tracking (malloc)", xl::Allocator::MODE_TRACKING, xl::Allocator::BLOCK_MALLOC,
+            xl::Allocator::PAGE_SIZE_BYTES, false, term_count);
+#endif
+    run("arena, malloc blocks", xl::Allocator::MODE_ARENA, xl::Allocator::BLOCK_MALLOC,
+            xl::Allocator::PAGE_SIZE_BYTES, false, term_count);
+    run("arena, mmap blocks", xl::Allocator::MODE_ARENA, xl::Allocator::BLOCK_MMAP,
+            xl::Allocator::PAGE_SIZE_BYTES, false, term_count);
+    run("arena, huge pages", xl::Allocator::MODE_ARENA, xl::Allocator::BLOCK_MMAP_HUGE,
+            xl::Allocator::HUGE_PAGE_SIZE_BYTES, false, term_count);
+    run("arena, huge pages, faulted", xl::Allocator::MODE_ARENA, xl::Allocator::BLOCK_MMAP_HUGE,
+            xl::Allocator::HUGE_PAGE_SIZE_BYTES, true, term_count);
+    return 0;
+}
@@ -0,0 +1,42 @@
+// XLang
+// -- A parser framework for language modeling
+// Copyright (C) 2011 onlyuser <mailto:onlyuser@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef XLANG_UNIT_TEST_H_
+#define XLANG_UNIT_TEST_H_
+
+#include "XLangType.h" // uint32_t
+#include <string> // std::string
+#include <iostream> // std::cerr
+#include <stdlib.h> // exit
+
+// a failed check fails the program, the unit suite runs each as its own test
+#define CHECK(x) \
+        do { \
+            if(!(x)) \
+            { \
+                std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #x << std::endl; \
+                exit(1); \
+            } \
+        } while(0)
+
+// node names are up to the client of libxl
+std::string id_to_name(uint32_t lexer_id)
+{
+    return "id_" + std::to_string(lexer_id);
+}
+
+#endif
@@ -0,0 +1,72 @@
+// XLang
+// -- A parser framework for language modeling
+// Copyright (C) 2011 onlyuser <mailto:onlyuser@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#include "XLangUnitTest.h" // CHECK
+#include "XLangAlloc.h" // Allocator
+#include <stdint.h> // uintptr_t
+
+static int live_count = 0;
+
+struct Counted
+{
+    char m_pad[40];
+
+    Counted() { live_count++; }
+    ~Counted() { live_count--; }
+};
+
+// same-sized chunks are handed out back to back from the current page, 16-byte aligned
+static void test_bump()
+{
+    xl::Allocator alloc("unit");
+    char* x = reinterpret_cast<char*>(alloc._malloc(32, PNEW_SITE));
+    char* y = reinterpret_cast<char*>(alloc._malloc(32, PNEW_SITE));
+    CHECK(y == x+32);
+    for(int i = 0; i < 100; i++)
+    {
+        void* z = alloc._malloc(1+i*5, PNEW_SITE);
+        CHECK(!(reinterpret_cast<uintptr_t>(z) & (xl::Allocator::ALIGN_BYTES-1)));
+    }
+    CHECK(alloc.size() >= 64+5*99*100/2);
+}
+
+// only chunks with a dtor are recorded, _free() runs their dtors in one sweep
+static void test_dtors()
+{
+    static const int ALLOC_COUNT = 100000;
+    {
+        xl::Allocator alloc("unit");
+        for(int i = 0; i < ALLOC_COUNT; i++)
+        {
+            new (PNEW(alloc, , Counted)) Counted;
+            alloc._malloc(24, PNEW_SITE);
+        }
+        CHECK(live_count == ALLOC_COUNT);
+        alloc._free();
+        CHECK(live_count == 0);
+        CHECK(alloc.size() == 0);
+        new (PNEW(alloc, , Counted)) Counted;
+    } // and so does the allocator going away
+    CHECK(live_count == 0);
+}
+
+int main()
+{
+    test_bump();
+    test_dtors();
+    return 0;
+}
@@ -0,0 +1,71 @@
+// XLang
+// -- A parser framework for language modeling
+// Copyright (C) 2011 onlyuser <mailto:onlyuser@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#include "XLangUnitTest.h" // CHECK
+#include "XLangAlloc.h" // Allocator, PNEW_ARRAY
+#include "XLangArenaVector.h" // ArenaVector
+
+static void test_array(xl::Allocator::mode_e mode)
+{
+    xl::Allocator alloc("unit", mode);
+    int* a = PNEW_ARRAY(alloc, int, 100);
+    CHECK(alloc.capacity(a) >= sizeof(int)*100);
+    for(int i = 0; i < 100; i++)
+        a[i] = i;
+
+    // grows in place while it fits, else moves with its contents
+    CHECK(alloc._realloc(a, alloc.capacity(a), __FILE__, __LINE__) == a);
+    int* b = reinterpret_cast<int*>(alloc._realloc(a, sizeof(int)*1000, __FILE__, __LINE__));
+    CHECK(b != a && alloc.capacity(b) >= sizeof(int)*1000);
+    for(int i = 0; i < 100; i++)
+        CHECK(b[i] == i);
+    alloc._free(b);
+    CHECK(alloc.size() == 0);
+}
+
+static void test_vector(xl::Allocator::mode_e mode)
+{
+    xl::Allocator alloc("unit", mode);
+    {
+        xl::ArenaVector<int, 2> vec(alloc);
+        vec.push_back(1);
+        vec.push_back(2);
+        CHECK(vec.is_inline() && alloc.size() == 0); // small lists cost no allocation
+        for(int i = 3; i <= 100; i++)
+            vec.push_back(i);
+        CHECK(!vec.is_inline() && vec.size() == 100 && alloc.size() > 0);
+        for(int i = 0; i < 100; i++)
+            CHECK(vec[i] == i+1);
+        int range[] = {-1, -2, -3};
+        vec.insert(vec.begin()+1, range, range+3);
+        CHECK(vec.size() == 103 && vec[0] == 1 && vec[1] == -1 && vec[3] == -3 && vec[4] == 2);
+        vec.erase(vec.begin(), vec.begin()+4);
+        CHECK(vec.size() == 99 && vec[0] == 2 && vec[98] == 100);
+        vec.clear();
+        CHECK(vec.empty());
+    }
+    CHECK(alloc.size() == 0); // the spilled buffer is freed with the vector
+}
+
+int main()
+{
+    test_array(xl::Allocator::MODE_ARENA);
+    test_array(xl::Allocator::MODE_TRACKING);
+    test_vector(xl::Allocator::MODE_ARENA);
+    test_vector(xl::Allocator::MODE_TRACKING);
+    return 0;
+}
@@ -0,0 +1,81 @@
+// XLang
+// -- A parser framework for language modeling
+// Copyright (C) 2011 onlyuser <mailto:onlyuser@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#include "XLangUnitTest.h" // CHECK
+#include "XLangAlloc.h" // Allocator
+#include <string.h> // memset
+#include <stdint.h> // uintptr_t
+
+// fills size_bytes with 256-byte chunks, writing each, and returns the first
+static char* fill(xl::Allocator &alloc, size_t size_bytes)
+{
+    char* first = NULL;
+    for(size_t i = 0; i < size_bytes/256; i++)
+    {
+        char* ptr = reinterpret_cast<char*>(alloc._malloc(256, __FILE__, __LINE__));
+        memset(ptr, static_cast<int>(i), 256);
+        if(!first)
+            first = ptr;
+    }
+    return first;
+}
+
+// the block source can only be picked while the allocator has no pages
+static void test_set_block_source()
+{
+    xl::Allocator alloc("unit");
+    CHECK(!alloc.set_block_source(xl::Allocator::BLOCK_MMAP, 1000));
+    CHECK(!alloc.set_block_source(xl::Allocator::BLOCK_MMAP, xl::Allocator::SLAB_SIZE_BYTES*3/2));
+    CHECK(alloc.set_block_source(xl::Allocator::BLOCK_MMAP));
+    xl::Allocator child("child", alloc);
+    CHECK(!child.set_block_source(xl::Allocator::BLOCK_MALLOC));
+    alloc._malloc(16, __FILE__, __LINE__);
+    CHECK(!alloc.set_block_source(xl::Allocator::BLOCK_MALLOC));
+}
+
+static void test_block_source(xl::Allocator::block_source_e block_source, size_t block_size_bytes,
+        bool prefault)
+{
+    xl::Allocator alloc("unit");
+    CHECK(alloc.set_block_source(block_source, block_size_bytes, prefault));
+    char* first = fill(alloc, block_size_bytes*2);
+    if(block_source == xl::Allocator::BLOCK_MMAP_HUGE)
+        CHECK(reinterpret_cast<uintptr_t>(first)%xl::Allocator::HUGE_PAGE_SIZE_BYTES < xl::Allocator::SLAB_SIZE_BYTES);
+    CHECK(first[0] == 0 && first[255] == 0);
+    {
+        // a child arena takes its parent's pages, and gives them back
+        alloc.reset();
+        xl::Allocator child("child", alloc);
+        fill(child, block_size_bytes);
+    }
+    alloc.reset();
+    CHECK(fill(alloc, block_size_bytes*2) == first); // the retained blocks are used again
+    alloc.reset(0);
+    CHECK(alloc.size() == 0);
+    fill(alloc, block_size_bytes);
+}
+
+int main()
+{
+    test_set_block_source();
+    test_block_source(xl::Allocator::BLOCK_MALLOC, xl::Allocator::PAGE_SIZE_BYTES, false);
+    test_block_source(xl::Allocator::BLOCK_MMAP, xl::Allocator::PAGE_SIZE_BYTES, false);
+    test_block_source(xl::Allocator::BLOCK_MMAP, xl::Allocator::PAGE_SIZE_BYTES*4, true);
+    test_block_source(xl::Allocator::BLOCK_MMAP_HUGE, xl::Allocator::HUGE_PAGE_SIZE_BYTES, false);
+    test_block_source(xl::Allocator::BLOCK_MMAP_HUGE, xl::Allocator::HUGE_PAGE_SIZE_BYTES, true);
+    return 0;
+}
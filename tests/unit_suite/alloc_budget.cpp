@@ -0,0 +1,141 @@
+// XLang
+// -- A parser framework for language modeling
+// Copyright (C) 2011 onlyuser <mailto:onlyuser@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#include "XLangUnitTest.h" // CHECK
+#include "XLangAlloc.h" // Allocator, BudgetExceeded
+#include "XLangTreeContext.h" // TreeContext
+#include "mvc/XLangMVCModel.h" // mvc::MVCModel
+#include "node/XLangNode.h" // node::SymbolNode
+#include <vector> // std::vector
+
+static bool try_malloc(xl::Allocator &alloc, size_t size_bytes)
+{
+    try
+    {
+        alloc._malloc(size_bytes, __FILE__, __LINE__);
+    }
+    catch(xl::BudgetExceeded &e)
+    {
+        return false;
+    }
+    return true;
+}
+
+static void test_byte_budget(xl::Allocator::mode_e mode)
+{
+    xl::Allocator alloc("unit", mode);
+    alloc.set_budget(1000);
+    CHECK(try_malloc(alloc, 400));
+    CHECK(!try_malloc(alloc, 800));
+    CHECK(try_malloc(alloc, 100)); // still usable after a refusal
+    alloc.reset();
+    CHECK(try_malloc(alloc, 800));
+}
+
+static void test_chunk_budget(xl::Allocator::mode_e mode)
+{
+    xl::Allocator alloc("unit", mode);
+    alloc.set_budget(static_cast<size_t>(-1), 3);
+    for(int i = 0; i < 3; i++)
+        CHECK(try_malloc(alloc, 8));
+    CHECK(!try_malloc(alloc, 8));
+    alloc.reset();
+    CHECK(try_malloc(alloc, 8));
+}
+
+// The node fits the budget but its child list doesn't, so its constructor throws. The
+// chunk of the node is given back, and its dtor is never run.
+static void test_throwing_ctor(xl::Allocator::mode_e mode)
+{
+    xl::Allocator term_alloc("terms", mode);
+    xl::TreeContext term_tc(term_alloc);
+    std::vector<xl::node::NodeIdentIFace*> vec;
+    for(long i = 0; i < 5; i++)
+        vec.push_back(xl::mvc::MVCModel::make_term(&term_tc, 0, i));
+    xl::Allocator alloc("unit", mode);
+    xl::TreeContext tc(alloc);
+    alloc.set_budget(static_cast<size_t>(-1), 1);
+    xl::Allocator::mark_t m = alloc.mark();
+    bool thrown = false;
+    try
+    {
+        xl::mvc::MVCModel::make_symbol(&tc, 1, vec);
+    }
+    catch(xl::BudgetExceeded &e)
+    {
+        thrown = true;
+    }
+    CHECK(thrown);
+    CHECK(alloc.size() == 0);
+    alloc.rollback(m);
+    alloc.reset();
+    alloc.set_budget(static_cast<size_t>(-1));
+    CHECK(xl::node::node_cast<xl::node::SymbolNodeIFace>(xl::mvc::MVCModel::make_symbol(&tc, 1, vec))->size() == 5);
+}
+
+// child arenas draw from their root's budget, and give back what they held when popped
+static void test_child_arenas(xl::Allocator::mode_e mode)
+{
+    static const size_t MAX_BYTES = 64*1024;
+    xl::Allocator alloc("unit", mode);
+    alloc.set_budget(MAX_BYTES);
+    xl::TreeContext tc(alloc);
+    for(int i = 0; i < 100; i++)
+    {
+        tc.push_arena();
+        for(size_t n = 0; n < MAX_BYTES/4; n += 64)
+            CHECK(try_malloc(tc.alloc(), 64));
+        tc.pop_arena();
+    }
+    size_t size_bytes = 0;
+    for(int i = 0; i < 1000; i++) // far past the budget, had each arena a budget of its own
+    {
+        try
+        {
+            tc.push_arena(); // nested, each pushed from the last
+        }
+        catch(xl::BudgetExceeded &e)
+        {
+            break;
+        }
+        int j = 0;
+        while(j < 64 && try_malloc(tc.alloc(), 64))
+            j++;
+        size_bytes += j*64;
+        if(j < 64)
+            break;
+    }
+    CHECK(size_bytes <= MAX_BYTES);
+    CHECK(size_bytes > MAX_BYTES/2);
+    CHECK(!try_malloc(alloc, 64));
+    while(tc.alloc().parent())
+        tc.pop_arena();
+    CHECK(try_malloc(alloc, 64));
+}
+
+int main()
+{
+    test_byte_budget(xl::Allocator::MODE_ARENA);
+    test_byte_budget(xl::Allocator::MODE_TRACKING);
+    test_chunk_budget(xl::Allocator::MODE_ARENA);
+    test_chunk_budget(xl::Allocator::MODE_TRACKING);
+    test_throwing_ctor(xl::Allocator::MODE_ARENA);
+    test_throwing_ctor(xl::Allocator::MODE_TRACKING);
+    test_child_arenas(xl::Allocator::MODE_ARENA);
+    test_child_arenas(xl::Allocator::MODE_TRACKING);
+    return 0;
+}
@@ -0,0 +1,198 @@
+// XLang
+// -- A parser framework for language modeling
+// Copyright (C) 2011 onlyuser <mailto:onlyuser@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#include "XLangUnitTest.h" // CHECK
+#include "XLangAlloc.h" // Allocator
+#include "XLangArenaVector.h" // ArenaVector
+#include <thread> // std::thread
+#include <vector> // std::vector
+#include <atomic> // std::atomic
+
+static const int THREAD_COUNT = 4;
+static const int ALLOC_COUNT  = 10000;
+
+static std::atomic<int> live_count(0);
+
+struct Counted
+{
+    char m_pad[24];
+
+    Counted() { live_count++; }
+    ~Counted() { live_count--; }
+};
+
+// every thread allocates from its own child arena, reset runs the dtors of all of them
+static void test_threads()
+{
+    xl::Allocator alloc("unit", xl::Allocator::MODE_ARENA, true);
+    std::vector<std::thread> thread_vec;
+    for(int i = 0; i < THREAD_COUNT; i++)
+    {
+        thread_vec.push_back(std::thread([&alloc]() {
+                for(int j = 0; j < ALLOC_COUNT; j++)
+                {
+                    Counted* x = new (PNEW(alloc, , Counted)) Counted;
+                    if(j%2)
+                        alloc._free(x);
+                }
+            }));
+    }
+    for(auto p = thread_vec.begin(); p != thread_vec.end(); ++p)
+        (*p).join();
+    CHECK(live_count == THREAD_COUNT*ALLOC_COUNT/2);
+    CHECK(alloc.size() > 0);
+    alloc.reset();
+    CHECK(live_count == 0);
+    CHECK(alloc.size() == 0);
+}
+
+// a chunk freed by another thread has its dtor run there, and is reused by its own thread
+static void test_remote_free(xl::Allocator::mode_e mode)
+{
+    xl::Allocator alloc("unit", mode, true);
+    std::vector<Counted*> x_vec;
+    std::atomic<int> stage(0);
+    size_t size_bytes = 0;
+    // kept alive until the frees are done, since a later thread may get the same thread id
+    std::thread owner([&alloc, &x_vec, &stage]() {
+            for(int i = 0; i < ALLOC_COUNT; i++)
+                x_vec.push_back(new (PNEW(alloc, , Counted)) Counted);
+            stage = 1;
+            while(stage != 2)
+                std::this_thread::yield();
+        });
+    while(stage != 1)
+        std::this_thread::yield();
+    size_bytes = alloc.size();
+    for(auto p = x_vec.begin(); p != x_vec.end(); ++p)
+        alloc._free(*p);
+    CHECK(live_count == 0);
+    CHECK(alloc.size() == size_bytes); // still held by the allocating thread's arena
+    stage = 2;
+    owner.join();
+    alloc.reset();
+    CHECK(alloc.size() == 0);
+    CHECK(live_count == 0);
+    // freed back and forth between two threads
+    std::atomic<Counted*> handoff(NULL);
+    std::thread producer([&alloc, &handoff]() {
+            for(int i = 0; i < ALLOC_COUNT; i++)
+            {
+                Counted* x = new (PNEW(alloc, , Counted)) Counted;
+                while(handoff.load())
+                    std::this_thread::yield();
+                handoff = x;
+            }
+        });
+    std::thread consumer([&alloc, &handoff]() {
+            for(int i = 0; i < ALLOC_COUNT; i++)
+            {
+                Counted* x = NULL;
+                while(!(x = handoff.exchange(NULL)))
+                    std::this_thread::yield();
+                alloc._free(x);
+            }
+        });
+    producer.join();
+    consumer.join();
+    CHECK(live_count == 0);
+    if(mode == xl::Allocator::MODE_ARENA)
+        CHECK(alloc.size() < ALLOC_COUNT*sizeof(Counted)); // the producer reused what came back
+}
+
+// an ArenaVector made by one thread keeps growing from whichever thread adds to it
+static void test_vector(xl::Allocator::mode_e mode)
+{
+    xl::Allocator alloc("unit", mode, true);
+    xl::ArenaVector<int, 2> v(alloc);
+    for(int i = 0; i < THREAD_COUNT; i++)
+    {
+        std::thread([&v, i]() {
+                for(int j = 0; j < ALLOC_COUNT; j++)
+                    v.push_back(i*ALLOC_COUNT+j);
+            }).join();
+    }
+    CHECK(v.size() == THREAD_COUNT*ALLOC_COUNT);
+    bool in_order = true;
+    for(int i = 0; i < THREAD_COUNT*ALLOC_COUNT; i++)
+        in_order &= (v[i] == i);
+    CHECK(in_order);
+}
+
+// all threads draw from the one budget, not one budget each
+static void test_shared_budget()
+{
+    static const size_t MAX_BYTES  = 256*1024;
+    static const size_t MAX_CHUNKS = 1000;
+    xl::Allocator alloc("unit", xl::Allocator::MODE_ARENA, true);
+    alloc.set_budget(MAX_BYTES);
+    std::atomic<size_t> alloc_count(0);
+    std::vector<std::thread> thread_vec;
+    for(int i = 0; i < THREAD_COUNT; i++)
+    {
+        thread_vec.push_back(std::thread([&alloc, &alloc_count]() {
+                try
+                {
+                    for(;;)
+                    {
+                        PNEW_ARRAY(alloc, char, 64);
+                        alloc_count++;
+                    }
+                }
+                catch(xl::BudgetExceeded &e)
+                {}
+            }));
+    }
+    for(auto p = thread_vec.begin(); p != thread_vec.end(); ++p)
+        (*p).join();
+    thread_vec.clear();
+    CHECK(alloc_count*64 <= MAX_BYTES);
+    CHECK(alloc_count*64 > MAX_BYTES/2);
+    CHECK(alloc.size() <= MAX_BYTES);
+    alloc.reset();
+    alloc.set_budget(static_cast<size_t>(-1), MAX_CHUNKS);
+    alloc_count = 0;
+    for(int i = 0; i < THREAD_COUNT; i++)
+    {
+        thread_vec.push_back(std::thread([&alloc, &alloc_count]() {
+                try
+                {
+                    for(;;)
+                    {
+                        alloc._free(PNEW_ARRAY(alloc, char, 64)); // frees don't give back allocations
+                        alloc_count++;
+                    }
+                }
+                catch(xl::BudgetExceeded &e)
+                {}
+            }));
+    }
+    for(auto p = thread_vec.begin(); p != thread_vec.end(); ++p)
+        (*p).join();
+    CHECK(alloc_count == MAX_CHUNKS);
+}
+
+int main()
+{
+    test_threads();
+    test_remote_free(xl::Allocator::MODE_ARENA);
+    test_remote_free(xl::Allocator::MODE_TRACKING);
+    test_vector(xl::Allocator::MODE_ARENA);
+    test_vector(xl::Allocator::MODE_TRACKING);
+    test_shared_budget();
+    return 0;
+}
@@ -0,0 +1,72 @@
+// XLang
+// -- A parser framework for language modeling
+// Copyright (C) 2011 onlyuser <mailto:onlyuser@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#include "XLangUnitTest.h" // CHECK
+#include "XLangAlloc.h" // Allocator
+
+static int live_count = 0;
+
+struct Counted
+{
+    char m_pad[40];
+
+    Counted() { live_count++; }
+    ~Counted() { live_count--; }
+};
+
+static void test_mark_rollback(xl::Allocator::mode_e mode)
+{
+    xl::Allocator alloc("unit", mode);
+    new (PNEW(alloc, , Counted)) Counted;
+    size_t size_bytes = alloc.size();
+    xl::Allocator::mark_t outer = alloc.mark();
+    new (PNEW(alloc, , Counted)) Counted;
+    alloc._malloc(3000, __FILE__, __LINE__);
+    xl::Allocator::mark_t inner = alloc.mark();
+    new (PNEW(alloc, , Counted)) Counted;
+    CHECK(live_count == 3);
+    alloc.rollback(inner);
+    CHECK(live_count == 2);
+    alloc.rollback(outer); // inner is gone already
+    CHECK(live_count == 1);
+    CHECK(alloc.size() == size_bytes);
+
+    // a chunk allocated before the mark and freed after it is still freed after a rollback
+    Counted* x = new (PNEW(alloc, , Counted)) Counted;
+    size_bytes = alloc.size();
+    xl::Allocator::mark_t m = alloc.mark();
+    alloc._free(x);
+    CHECK(live_count == 1);
+    alloc.rollback(m);
+    CHECK(live_count == 1);
+    CHECK(alloc.size() < size_bytes);
+
+    m = alloc.mark();
+    new (PNEW(alloc, , Counted)) Counted;
+    alloc.commit(m);
+    CHECK(live_count == 2);
+    alloc.reset();
+    CHECK(live_count == 0);
+    CHECK(alloc.size() == 0);
+}
+
+int main()
+{
+    test_mark_rollback(xl::Allocator::MODE_ARENA);
+    test_mark_rollback(xl::Allocator::MODE_TRACKING);
+    return 0;
+}
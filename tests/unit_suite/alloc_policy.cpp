@@ -0,0 +1,65 @@
+// XLang
+// -- A parser framework for language modeling
+// Copyright (C) 2011 onlyuser <mailto:onlyuser@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#include "XLangUnitTest.h" // CHECK
+#include "XLangAlloc.h" // Allocator, PNEW_SITE
+#include "XLangTreeContext.h" // TreeContext
+#include "mvc/XLangMVCModel.h" // mvc::MVCModel
+#include "node/XLangNode.h" // node::SymbolNode
+#include <string> // std::string
+#include <sstream> // std::stringstream
+#include <iostream> // std::cout
+
+static const char* site_filename(const char* filename, size_t line_number)
+{
+    return filename;
+}
+
+static std::string dump(const xl::Allocator &alloc)
+{
+    std::stringstream ss;
+    std::streambuf* prev_buf = std::cout.rdbuf(ss.rdbuf());
+    alloc.dump("");
+    std::cout.rdbuf(prev_buf);
+    return ss.str();
+}
+
+// the policy is picked for the whole build, libxl and this test alike
+static void test_policy()
+{
+    xl::Allocator alloc("unit", xl::Allocator::MODE_TRACKING);
+    xl::TreeContext tc(alloc);
+    xl::node::NodeIdentIFace* sum = xl::mvc::MVCModel::make_symbol(&tc, '+', 2,
+            xl::mvc::MVCModel::make_term(&tc, 0, 1L),
+            xl::mvc::MVCModel::make_term(&tc, 0, 2L));
+    CHECK(xl::node::node_cast<xl::node::SymbolNodeIFace>(sum)->size() == 2);
+#ifdef XLANG_NO_ALLOC_TRACKING
+    CHECK(alloc.mode() == xl::Allocator::MODE_ARENA);
+    CHECK(!site_filename(PNEW_SITE)); // no site is passed
+    CHECK(dump(alloc).find("arena .. ") != std::string::npos);
+#else
+    CHECK(alloc.mode() == xl::Allocator::MODE_TRACKING);
+    CHECK(std::string(site_filename(PNEW_SITE)) == __FILE__);
+    CHECK(dump(alloc).find("XLangMVCModel") != std::string::npos); // nodes are tracked by site
+#endif
+}
+
+int main()
+{
+    test_policy();
+    return 0;
+}
@@ -0,0 +1,81 @@
+// XLang
+// -- A parser framework for language modeling
+// Copyright (C) 2011 onlyuser <mailto:onlyuser@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#include "XLangUnitTest.h" // CHECK
+#include "XLangAlloc.h" // Allocator
+
+static int dtor_count = 0;
+
+// frees the chunk it points at, as a node does its child list
+struct Linked
+{
+    xl::Allocator* m_alloc;
+    Linked*        m_next;
+
+    Linked(xl::Allocator* _alloc, Linked* _next) : m_alloc(_alloc), m_next(_next) {}
+    ~Linked()
+    {
+        dtor_count++;
+        if(m_next)
+            m_alloc->_free(m_next);
+    }
+};
+
+// a freed slot goes back to its size class, and is the next one handed out for that class
+static void test_recycle()
+{
+    xl::Allocator alloc("unit");
+    void* x = alloc._malloc(40, PNEW_SITE);
+    void* y = alloc._malloc(40, PNEW_SITE);
+    size_t size_bytes = alloc.size();
+    alloc._free(x);
+    CHECK(alloc.size() < size_bytes);
+    void* z = alloc._malloc(100, PNEW_SITE); // another size class
+    CHECK(z != x);
+    CHECK(alloc._malloc(33, PNEW_SITE) == x); // same size class as 40
+    alloc._free(y);
+    alloc._free(z);
+    CHECK(alloc._malloc(40, PNEW_SITE) == y);
+    CHECK(alloc._malloc(100, PNEW_SITE) == z);
+    void* large = alloc._malloc(4000, PNEW_SITE); // past the pools
+    alloc._free(large);
+    CHECK(alloc.size() == size_bytes+112); // x and y, and z in the 112-byte class
+}
+
+// a dtor that frees the next chunk in the dtor list, while the list is being swept
+static void test_dtor_frees_next()
+{
+    xl::Allocator alloc("unit");
+    Linked* x = new (PNEW(alloc, , Linked)) Linked(&alloc, NULL);
+    new (PNEW(alloc, , Linked)) Linked(&alloc, x); // swept first
+    alloc.reset();
+    CHECK(dtor_count == 2);
+    dtor_count = 0;
+    xl::Allocator::mark_t m = alloc.mark();
+    x = new (PNEW(alloc, , Linked)) Linked(&alloc, NULL);
+    new (PNEW(alloc, , Linked)) Linked(&alloc, x);
+    alloc.rollback(m);
+    CHECK(dtor_count == 2);
+    CHECK(alloc.size() == 0);
+}
+
+int main()
+{
+    test_recycle();
+    test_dtor_frees_next();
+    return 0;
+}
@@ -0,0 +1,106 @@
+// XLang
+// -- A parser framework for language modeling
+// Copyright (C) 2011 onlyuser <mailto:onlyuser@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#include "XLangUnitTest.h" // CHECK
+#include "XLangAlloc.h" // Allocator
+#include <string> // std::string
+#include <sstream> // std::stringstream
+#include <iostream> // std::cout
+#include <stdio.h> // sscanf
+
+static int live_count = 0;
+
+struct Counted
+{
+    char m_pad[40];
+
+    Counted() { live_count++; }
+    ~Counted() { live_count--; }
+};
+
+// pages in use and pages held, from the arena line of dump()
+static std::pair<size_t, size_t> page_count(const xl::Allocator &alloc)
+{
+    std::stringstream ss;
+    std::streambuf* prev_buf = std::cout.rdbuf(ss.rdbuf());
+    alloc.dump("");
+    std::cout.rdbuf(prev_buf);
+    std::string s = ss.str();
+    size_t used = 0, held = 0;
+    size_t pos = s.find("arena .. ");
+    CHECK(pos != std::string::npos);
+    CHECK(sscanf(s.c_str()+pos, "arena .. %zu of %zu pages", &used, &held) == 2);
+    return std::make_pair(used, held);
+}
+
+static void fill(xl::Allocator &alloc, size_t size_bytes)
+{
+    for(size_t i = 0; i < size_bytes/256; i++)
+        alloc._malloc(256, __FILE__, __LINE__);
+}
+
+static void test_reuse_after_reset()
+{
+    xl::Allocator alloc("unit");
+    void* first = alloc._malloc(64, __FILE__, __LINE__);
+    void* large = alloc._malloc(10000, __FILE__, __LINE__);
+    alloc.reset();
+    CHECK(alloc._malloc(64, __FILE__, __LINE__) == first); // retained pages are reused
+    CHECK(alloc._malloc(10000, __FILE__, __LINE__) == large); // and so are large chunks
+    alloc.reset(0);
+    CHECK(alloc.size() == 0);
+}
+
+// a second parse of the same size takes no new pages, and a bound on what is kept is honored
+static void test_retained_pages()
+{
+    xl::Allocator alloc("unit");
+    fill(alloc, 3*xl::Allocator::PAGE_SIZE_BYTES);
+    std::pair<size_t, size_t> count = page_count(alloc);
+    CHECK(count.first >= 3 && count.first == count.second);
+    for(int i = 0; i < 10; i++)
+    {
+        alloc.reset();
+        CHECK(alloc.size() == 0 && page_count(alloc) == std::make_pair(size_t(0), count.second));
+        fill(alloc, 3*xl::Allocator::PAGE_SIZE_BYTES);
+        CHECK(page_count(alloc) == count);
+    }
+    alloc.reset(xl::Allocator::PAGE_SIZE_BYTES);
+    CHECK(page_count(alloc) == std::make_pair(size_t(0), size_t(1)));
+    alloc.reset(0);
+    CHECK(page_count(alloc) == std::make_pair(size_t(0), size_t(0)));
+}
+
+static void test_dtors()
+{
+    xl::Allocator alloc("unit");
+    for(int i = 0; i < 1000; i++)
+        new (PNEW(alloc, , Counted)) Counted;
+    alloc.reset();
+    CHECK(live_count == 0);
+    new (PNEW(alloc, , Counted)) Counted;
+    alloc.reset(0);
+    CHECK(live_count == 0);
+}
+
+int main()
+{
+    test_reuse_after_reset();
+    test_retained_pages();
+    test_dtors();
+    return 0;
+}
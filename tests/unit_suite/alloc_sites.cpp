@@ -0,0 +1,88 @@
+// XLang
+// -- A parser framework for language modeling
+// Copyright (C) 2011 onlyuser <mailto:onlyuser@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#include "XLangUnitTest.h" // CHECK
+#include "XLangAlloc.h" // Allocator
+#include <string> // std::string
+#include <sstream> // std::stringstream
+#include <iostream> // std::cout
+#include <vector> // std::vector
+
+// sites are only recorded in tracking mode
+#ifndef XLANG_NO_ALLOC_TRACKING
+
+struct Counted
+{
+    char m_pad[24];
+};
+
+static std::string dump(const xl::Allocator &alloc)
+{
+    std::stringstream ss;
+    std::streambuf* prev_buf = std::cout.rdbuf(ss.rdbuf());
+    alloc.dump("");
+    std::cout.rdbuf(prev_buf);
+    return ss.str();
+}
+
+static bool has_line(std::string s, std::string line)
+{
+    return s.find(line + "\n") != std::string::npos;
+}
+
+// one record per site, whatever the number of chunks
+static void test_site_counts()
+{
+    xl::Allocator alloc("unit", xl::Allocator::MODE_TRACKING);
+    std::vector<void*> ptr_vec;
+    for(int i = 0; i < 10; i++)
+        ptr_vec.push_back(alloc._malloc(32, "a.cpp", 1));
+    alloc._malloc(100, "b.cpp", 2);
+    for(int i = 0; i < 4; i++)
+        alloc._free(ptr_vec[i]);
+    std::string s = dump(alloc);
+    CHECK(has_line(s, "a.cpp:1 .. 192 bytes in 6 live chunks, peak 320 bytes, 320 bytes in 10 allocs"));
+    CHECK(has_line(s, "b.cpp:2 .. 100 bytes in 1 live chunks, peak 100 bytes, 100 bytes in 1 allocs"));
+    CHECK(s.find("a.cpp:1") < s.find("b.cpp:2")); // most live bytes first
+}
+
+// the same site seen through two copies of its filename is printed once, a dtor makes it another site
+static void test_site_merge()
+{
+    static const char filename_1[] = "c.cpp";
+    static const char filename_2[] = "c.cpp";
+    xl::Allocator alloc("unit", xl::Allocator::MODE_TRACKING);
+    alloc._malloc(16, filename_1, 3);
+    alloc._malloc(16, filename_2, 3);
+    new (PNEW(alloc, , Counted)) Counted;
+    std::string s = dump(alloc);
+    CHECK(has_line(s, "c.cpp:3 .. 32 bytes in 2 live chunks, peak 32 bytes, 32 bytes in 2 allocs"));
+    CHECK(s.find(" (dtor) .. 24 bytes in 1 live chunks") != std::string::npos);
+    alloc.reset(); // sites outlive their chunks
+    CHECK(has_line(dump(alloc), "c.cpp:3 .. 0 bytes in 0 live chunks, peak 32 bytes, 32 bytes in 2 allocs"));
+}
+
+#endif
+
+int main()
+{
+#ifndef XLANG_NO_ALLOC_TRACKING
+    test_site_counts();
+    test_site_merge();
+#endif
+    return 0;
+}
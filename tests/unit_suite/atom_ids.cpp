@@ -0,0 +1,57 @@
+// XLang
+// -- A parser framework for language modeling
+// Copyright (C) 2011 onlyuser <mailto:onlyuser@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#include "XLangUnitTest.h" // CHECK
+#include "XLangTreeContext.h" // TreeContext
+#include "mvc/XLangMVCModel.h" // mvc::MVCModel
+#include "node/XLangNode.h" // node::TermNode
+#include <string> // std::string
+
+// ids are dense, in interning order
+static void test_atom_ids()
+{
+    xl::Allocator alloc("unit");
+    xl::TreeContext tc(alloc);
+    for(int i = 0; i < 1000; i++)
+        CHECK(xl::TreeContext::atom_id(tc.alloc_unique_string("s" + std::to_string(i))) == static_cast<uint32_t>(i));
+    CHECK(xl::TreeContext::atom_id(tc.alloc_unique_string("s7")) == 7 && tc.atom_count() == 1000);
+
+    // an IDENT term answers with its string's id
+    xl::node::NodeIdentIFace* ident = xl::mvc::MVCModel::make_term(&tc, 0, tc.alloc_unique_string("s42"));
+    CHECK(xl::node::node_cast<xl::node::TermNodeIFace<xl::node::NodeIdentIFace::IDENT>>(ident)->atom_id() == 42);
+}
+
+static void test_rollback()
+{
+    xl::Allocator alloc("unit");
+    xl::TreeContext tc(alloc);
+    tc.alloc_unique_string("x");
+    xl::TreeContext::mark_t m = tc.mark();
+    const std::string* y = tc.alloc_unique_string("y");
+    CHECK(xl::TreeContext::atom_id(y) == 1);
+    tc.rollback(m);
+    CHECK(tc.atom_count() == 1);
+    CHECK(xl::TreeContext::atom_id(tc.alloc_unique_string("z")) == 1); // the atom id is handed out again
+    CHECK(xl::TreeContext::atom_id(tc.alloc_unique_string("x")) == 0);
+}
+
+int main()
+{
+    test_atom_ids();
+    test_rollback();
+    return 0;
+}
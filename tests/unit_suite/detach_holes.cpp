@@ -0,0 +1,132 @@
+// XLang
+// -- A parser framework for language modeling
+// Copyright (C) 2011 onlyuser <mailto:onlyuser@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#include "XLangUnitTest.h" // CHECK
+#include "mvc/XLangMVCModel.h" // mvc::MVCModel
+#include "node/XLangNode.h" // node::SymbolNode
+#include <vector> // std::vector
+#include <algorithm> // std::find
+
+using namespace xl;
+
+static node::SymbolNodeIFace* make_list(TreeContext* tc, long n)
+{
+    std::vector<node::NodeIdentIFace*> vec;
+    for(long i = 0; i < n; i++)
+        vec.push_back(mvc::MVCModel::make_term(tc, 0, i));
+    return node::node_cast<node::SymbolNodeIFace>(mvc::MVCModel::make_symbol(tc, 1, vec));
+}
+
+static long value(const node::NodeIdentIFace* _node)
+{
+    return node::node_cast<node::TermNodeIFace<node::NodeIdentIFace::INT>>(_node)->value();
+}
+
+// detached and erased children drop out, the rest keep their order and know their index
+static void test_detach()
+{
+    Allocator alloc("unit");
+    TreeContext tc(alloc);
+    node::SymbolNodeIFace* list = make_list(&tc, 10);
+    node::NodeIdentIFace* third = (*list)[3];
+    (*list)[0]->detach();
+    (*list)[5]->detach(); // was at 6
+    list->erase(0); // was at 1
+    CHECK(third->index() == 1);
+    CHECK(list->size() == 7);
+    long expected[] = {2, 3, 4, 5, 7, 8, 9};
+    for(size_t i = 0; i < list->size(); i++)
+    {
+        CHECK(value((*list)[i]) == expected[i]);
+        CHECK((*list)[i]->index() == static_cast<int>(i));
+    }
+    third->detach();
+    CHECK(third->is_root() && third->index() == -1);
+    list->push_front(third);
+    CHECK(third->index() == 0 && (*list)[1]->index() == 1 && list->size() == 7);
+}
+
+static void test_detach_all()
+{
+    Allocator alloc("unit");
+    TreeContext tc(alloc);
+    node::SymbolNodeIFace* list = make_list(&tc, 1000);
+    for(long i = 0; list->size(); i++)
+    {
+        CHECK(value((*list)[0]) == i);
+        (*list)[0]->detach();
+    }
+    list = make_list(&tc, 1000);
+    std::vector<node::NodeIdentIFace*> child_vec;
+    for(size_t i = 0; i < list->size(); i++)
+        child_vec.push_back((*list)[i]);
+    for(size_t i = 0; i < child_vec.size(); i++)
+    {
+        CHECK(child_vec[i]->index() == 0);
+        child_vec[i]->detach();
+    }
+    CHECK(list->size() == 0);
+}
+
+// a long list keeps its holes between reads, checked against a plain vector
+static void test_model()
+{
+    Allocator alloc("unit");
+    TreeContext tc(alloc);
+    node::SymbolNodeIFace* list = make_list(&tc, 0);
+    std::vector<node::NodeIdentIFace*> model;
+    unsigned seed = 1;
+    for(long i = 0; i < 20000; i++)
+    {
+        seed = seed*1103515245+12345;
+        size_t r = (seed >> 8)%1000;
+        node::NodeIdentIFace* term = mvc::MVCModel::make_term(&tc, 0, i);
+        if(model.size() < 64 || r%6 < 3)
+        {
+            list->push_back(term);
+            model.push_back(term);
+        }
+        else if(r%6 == 3)
+        {
+            node::NodeIdentIFace* child = model[r%model.size()];
+            child->detach();
+            model.erase(std::find(model.begin(), model.end(), child));
+        }
+        else if(r%6 == 4)
+        {
+            list->erase(r%model.size());
+            model.erase(model.begin()+r%model.size());
+        }
+        else
+        {
+            node::NodeIdentIFace* child = model[r%model.size()];
+            CHECK(child->index() == std::find(model.begin(), model.end(), child)-model.begin());
+            CHECK((*list)[r%model.size()] == model[r%model.size()]);
+        }
+        CHECK(list->size() == model.size());
+    }
+    for(size_t i = 0; i < model.size(); i++)
+        CHECK((*list)[i] == model[i] && model[i]->index() == static_cast<int>(i));
+}
+
+int main()
+{
+    test_detach();
+    test_detach_all();
+    test_model();
+    return 0;
+}
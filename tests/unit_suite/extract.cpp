@@ -0,0 +1,97 @@
+// XLang
+// -- A parser framework for language modeling
+// Copyright (C) 2011 onlyuser <mailto:onlyuser@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#include "XLangUnitTest.h" // CHECK
+#include "mvc/XLangMVCModel.h" // mvc::MVCModel
+#include "node/XLangNode.h" // node::SymbolNode
+
+using namespace xl;
+
+// the copy survives the arena it was copied from
+static void test_self_contained()
+{
+    Allocator dst_alloc("dst");
+    TreeContext dst(dst_alloc);
+    node::NodeIdentIFace* copy = NULL;
+    size_t hash = 0;
+    {
+        Allocator src_alloc("src");
+        TreeContext src(src_alloc);
+        node::NodeIdentIFace* root = mvc::MVCModel::make_symbol(&src, '+', 3,
+                mvc::MVCModel::make_term(&src, 0, src.alloc_unique_string("x")),
+                mvc::MVCModel::make_term(&src, 1, src.alloc_string("s")),
+                NULL);
+        copy = mvc::MVCModel::extract(&dst, root);
+        hash = root->hash();
+    }
+    CHECK(copy->is_root() && copy->hash() == hash);
+    auto symbol = node::node_cast<node::SymbolNodeIFace>(copy);
+    CHECK(symbol->size() == 3 && (*symbol)[2] == NULL && (*symbol)[1]->parent() == copy);
+    const std::string* x = node::node_cast<node::TermNodeIFace<node::NodeIdentIFace::IDENT>>((*symbol)[0])->value();
+    CHECK(dst.alloc_unique_string("x") == x);
+}
+
+// a hash-consed DAG is copied once per node, not once per path
+static void test_shared()
+{
+    static const int DEPTH = 40;
+    Allocator src_alloc("src");
+    TreeContext src(src_alloc);
+    src.set_hash_cons(true);
+    node::NodeIdentIFace* root = mvc::MVCModel::make_term(&src, 0, 1L);
+    for(int i = 0; i < DEPTH; i++)
+        root = mvc::MVCModel::make_symbol(&src, 100+i, 2, root, root);
+    Allocator dst_alloc("dst");
+    TreeContext dst(dst_alloc);
+    node::NodeIdentIFace* copy = mvc::MVCModel::extract(&dst, root);
+    CHECK(copy->hash() == root->hash());
+    node::NodeIdentIFace* _node = copy;
+    for(int i = 0; i < DEPTH; i++)
+    {
+        auto symbol = node::node_cast<node::SymbolNodeIFace>(_node);
+        CHECK((*symbol)[0] == (*symbol)[1]);
+        CHECK((*symbol)[0]->parent() == _node && (*symbol)[0]->is_shared() && (*symbol)[0]->index() == 0);
+        _node = (*symbol)[0];
+    }
+}
+
+// a lazy clone is copied as the tree it reads as, and the copy is its own
+static void test_lazy_source()
+{
+    Allocator src_alloc("src");
+    TreeContext src(src_alloc);
+    node::NodeIdentIFace* root = mvc::MVCModel::make_symbol(&src, '+', 2,
+            mvc::MVCModel::make_term(&src, 0, 1L),
+            mvc::MVCModel::make_symbol(&src, '*', 1, mvc::MVCModel::make_term(&src, 0, 2L)));
+    src.set_lazy_clone(true);
+    node::NodeIdentIFace* clone = root->clone(&src);
+    src.set_lazy_clone(false);
+    Allocator dst_alloc("dst");
+    TreeContext dst(dst_alloc);
+    node::NodeIdentIFace* copy = mvc::MVCModel::extract(&dst, clone);
+    CHECK(copy->compare(root) && copy->hash() == root->hash());
+    auto symbol = node::node_cast<node::SymbolNodeIFace>(copy);
+    CHECK((*symbol)[1] != (*node::node_cast<node::SymbolNodeIFace>(root))[1] && (*symbol)[1]->parent() == copy);
+}
+
+int main()
+{
+    test_self_contained();
+    test_shared();
+    test_lazy_source();
+    return 0;
+}
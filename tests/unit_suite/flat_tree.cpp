@@ -0,0 +1,97 @@
+// XLang
+// -- A parser framework for language modeling
+// Copyright (C) 2011 onlyuser <mailto:onlyuser@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#include "XLangUnitTest.h" // CHECK
+#include "mvc/XLangMVCModel.h" // mvc::MVCModel
+#include "node/XLangNode.h" // node::SymbolNode
+#include "node/XLangFlatTree.h" // node::FlatTree
+#include <string> // std::string
+
+using namespace xl;
+
+// (+ 1 "s" (* x NULL) 'c')
+static node::NodeIdentIFace* make_tree(TreeContext* tc)
+{
+    return mvc::MVCModel::make_symbol(tc, '+', 4,
+            mvc::MVCModel::make_term(tc, 0, 1L),
+            mvc::MVCModel::make_term(tc, 1, tc->alloc_string("s")),
+            mvc::MVCModel::make_symbol(tc, '*', 2,
+                    mvc::MVCModel::make_term(tc, 2, tc->alloc_unique_string("x")),
+                    NULL),
+            mvc::MVCModel::make_term(tc, 3, 'c'));
+}
+
+static void test_layout()
+{
+    Allocator alloc("unit");
+    TreeContext tc(alloc);
+    node::FlatTree flat(make_tree(&tc));
+    CHECK(flat.size() == 7); // preorder, the NULL child included
+    CHECK(flat.type(0) == node::NodeIdentIFace::SYMBOL && flat.parent(0) == -1);
+    CHECK(flat.subtree_size(0) == 7 && flat.child_count(0) == 4);
+    CHECK(flat.value<node::NodeIdentIFace::INT>(flat.child(0, 0)) == 1);
+    size_t product = flat.child(0, 2);
+    CHECK(flat.lexer_id(product) == '*' && flat.parent(product) == 0 && flat.subtree_size(product) == 3);
+    CHECK(*flat.value<node::NodeIdentIFace::IDENT>(flat.child(product, 0)) == "x");
+    CHECK(flat.type(flat.child(product, 1)) == node::FlatTree::NIL);
+    CHECK(flat.value<node::NodeIdentIFace::CHAR>(flat.child(0, 3)) == 'c');
+}
+
+// seen through the node interfaces, the snapshot equals the tree it was taken from
+static void test_view()
+{
+    Allocator alloc("unit");
+    TreeContext tc(alloc);
+    node::NodeIdentIFace* root = make_tree(&tc);
+    node::FlatTree flat(root);
+    node::FlatTreeView view(flat);
+    const node::NodeIdentIFace* view_root = view.root();
+    CHECK(view_root->hash() == root->hash());
+    CHECK(root->compare(view_root));
+    auto view_symbol = node::node_cast<node::SymbolNodeIFace>(view_root);
+    CHECK((*view_symbol)[2]->parent() == view_root && (*view_symbol)[2]->index() == 2);
+    CHECK((*node::node_cast<node::SymbolNodeIFace>((*view_symbol)[2]))[1] == NULL);
+    CHECK(std::string(node::node_cast<node::TermNodeIFace<node::NodeIdentIFace::STRING>>((*view_symbol)[1])->value()->c_str()) == "s");
+}
+
+// a snapshot sees a node's children as its readers do, without removed ones or lazy copies
+static void test_edited_source()
+{
+    Allocator alloc("unit");
+    TreeContext tc(alloc);
+    node::NodeIdentIFace* root = make_tree(&tc);
+    (*node::node_cast<node::SymbolNodeIFace>(root))[1]->detach();
+    node::FlatTree flat(root);
+    CHECK(flat.size() == 6 && flat.child_count(0) == 3);
+    CHECK(flat.lexer_id(flat.child(0, 1)) == '*');
+    tc.set_lazy_clone(true);
+    node::NodeIdentIFace* clone = root->clone(&tc);
+    tc.set_lazy_clone(false);
+    size_t size_bytes = alloc.size();
+    node::FlatTree clone_flat(clone);
+    CHECK(alloc.size() == size_bytes);
+    CHECK(clone_flat.size() == 6);
+    CHECK(root->compare(node::FlatTreeView(clone_flat).root()));
+}
+
+int main()
+{
+    test_layout();
+    test_view();
+    test_edited_source();
+    return 0;
+}
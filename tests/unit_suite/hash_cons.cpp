@@ -0,0 +1,92 @@
+// XLang
+// -- A parser framework for language modeling
+// Copyright (C) 2011 onlyuser <mailto:onlyuser@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#include "XLangUnitTest.h" // CHECK
+#include "mvc/XLangMVCModel.h" // mvc::MVCModel
+#include "node/XLangNode.h" // node::SymbolNode
+
+using namespace xl;
+
+static void test_shared_nodes()
+{
+    Allocator alloc("unit");
+    TreeContext tc(alloc);
+    tc.set_hash_cons(true);
+    node::NodeIdentIFace* one = mvc::MVCModel::make_term(&tc, 0, 1L);
+    CHECK(mvc::MVCModel::make_term(&tc, 0, 1L) == one);
+    CHECK(mvc::MVCModel::make_term(&tc, 1, 1L) != one);
+    CHECK(mvc::MVCModel::make_term(&tc, 0, tc.alloc_unique_string("x")) ==
+            mvc::MVCModel::make_term(&tc, 0, tc.alloc_unique_string("x")));
+    node::NodeIdentIFace* two = mvc::MVCModel::make_term(&tc, 0, 2L);
+    node::NodeIdentIFace* sum = mvc::MVCModel::make_symbol(&tc, '+', 2, one, two);
+    CHECK(mvc::MVCModel::make_symbol(&tc, '+', 2, one, two) == sum);
+    CHECK(mvc::MVCModel::make_symbol(&tc, '+', 3, one, node::SymbolNode::eol(), two) == sum);
+
+    // a child adopted by a second parent keeps the first, and is marked shared
+    node::NodeIdentIFace* product = mvc::MVCModel::make_symbol(&tc, '*', 2, sum, two);
+    node::NodeIdentIFace* difference = mvc::MVCModel::make_symbol(&tc, '-', 2, two, sum);
+    CHECK(sum->parent() == product && sum->is_shared() && sum->index() == 0);
+    node::node_cast<node::SymbolNodeIFace>(difference)->erase(0);
+    node::node_cast<node::SymbolNodeIFace>(difference)->remove_first(sum);
+    CHECK(sum->parent() == product && sum->index() == 0);
+    CHECK(two->parent() == sum && two->index() == 1);
+}
+
+// the children of a flattened same-type child stay with it, and are shared
+static void test_flatten()
+{
+    Allocator alloc("unit");
+    TreeContext tc(alloc);
+    tc.set_hash_cons(true);
+    node::NodeIdentIFace* a = mvc::MVCModel::make_term(&tc, 0, 1L);
+    node::NodeIdentIFace* b = mvc::MVCModel::make_term(&tc, 0, 2L);
+    node::NodeIdentIFace* c = mvc::MVCModel::make_term(&tc, 0, 3L);
+    node::NodeIdentIFace* ab = mvc::MVCModel::make_symbol(&tc, ',', 2, a, b);
+    node::NodeIdentIFace* abc = mvc::MVCModel::make_symbol(&tc, ',', 2, ab, c);
+    CHECK(node::node_cast<node::SymbolNodeIFace>(abc)->size() == 3);
+    CHECK(a->parent() == ab && a->is_shared() && a->index() == 0);
+    CHECK(b->parent() == ab && b->is_shared() && b->index() == 1);
+    CHECK(c->parent() == abc && c->index() == 2);
+    CHECK((*node::node_cast<node::SymbolNodeIFace>(abc))[1] == b);
+
+    // the interned child is found again with its children intact
+    CHECK(mvc::MVCModel::make_symbol(&tc, ',', 2, a, b) == ab);
+    CHECK(node::node_cast<node::SymbolNodeIFace>(ab)->size() == 2);
+    CHECK(a->parent() == ab && a->index() == 0);
+    CHECK(b->parent() == ab && b->index() == 1);
+}
+
+static void test_rollback()
+{
+    Allocator alloc("unit");
+    TreeContext tc(alloc);
+    tc.set_hash_cons(true);
+    node::NodeIdentIFace* one = mvc::MVCModel::make_term(&tc, 0, 1L);
+    TreeContext::mark_t m = tc.mark();
+    mvc::MVCModel::make_term(&tc, 0, 2L);
+    tc.rollback(m);
+    CHECK(mvc::MVCModel::make_term(&tc, 0, 1L) == one);
+    CHECK(mvc::MVCModel::make_term(&tc, 0, 2L)->hash() != 0); // a fresh node, not the rolled back one
+}
+
+int main()
+{
+    test_shared_nodes();
+    test_flatten();
+    test_rollback();
+    return 0;
+}
@@ -0,0 +1,83 @@
+// XLang
+// -- A parser framework for language modeling
+// Copyright (C) 2011 onlyuser <mailto:onlyuser@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#include "XLangUnitTest.h" // CHECK
+#include "mvc/XLangMVCModel.h" // mvc::MVCModel
+#include "node/XLangNode.h" // node::SymbolNode
+#include <vector> // std::vector
+
+using namespace xl;
+
+static node::SymbolNodeIFace* symbol(node::NodeIdentIFace* _node)
+{
+    return node::node_cast<node::SymbolNodeIFace>(_node);
+}
+
+// bytes make_symbol takes for a node with n children, made beforehand
+static size_t symbol_size(Allocator &alloc, TreeContext* tc, size_t n)
+{
+    std::vector<node::NodeIdentIFace*> vec;
+    for(size_t i = 0; i < n; i++)
+        vec.push_back(mvc::MVCModel::make_term(tc, 0, static_cast<long>(i)));
+    size_t size_bytes = alloc.size();
+    mvc::MVCModel::make_symbol(tc, 1, vec);
+    return alloc.size()-size_bytes;
+}
+
+// unary and binary nodes keep their children inline, with no second allocation
+static void test_inline(Allocator::mode_e mode)
+{
+    Allocator alloc("unit", mode);
+    TreeContext tc(alloc);
+    size_t leaf_size = symbol_size(alloc, &tc, 0);
+    CHECK(symbol_size(alloc, &tc, 1) == leaf_size);
+    CHECK(symbol_size(alloc, &tc, 2) == leaf_size);
+    CHECK(symbol_size(alloc, &tc, 3) > leaf_size);
+}
+
+// a binary node grown past its inline slots keeps its children in order
+static void test_spill(Allocator::mode_e mode)
+{
+    Allocator alloc("unit", mode);
+    TreeContext tc(alloc);
+    node::NodeIdentIFace* a = mvc::MVCModel::make_term(&tc, 0, 1L);
+    node::NodeIdentIFace* b = mvc::MVCModel::make_term(&tc, 0, 2L);
+    node::NodeIdentIFace* ab = mvc::MVCModel::make_symbol(&tc, 1, 2, a, b);
+    std::vector<node::NodeIdentIFace*> child_vec;
+    child_vec.push_back(a);
+    child_vec.push_back(b);
+    for(long i = 3; i <= 10; i++)
+    {
+        node::NodeIdentIFace* child = mvc::MVCModel::make_term(&tc, 0, i);
+        symbol(ab)->push_back(child);
+        child_vec.push_back(child);
+    }
+    symbol(ab)->remove_first(b);
+    child_vec.erase(child_vec.begin()+1);
+    CHECK(symbol(ab)->size() == child_vec.size());
+    for(size_t i = 0; i < child_vec.size(); i++)
+        CHECK((*symbol(ab))[i] == child_vec[i] && child_vec[i]->index() == static_cast<int>(i));
+}
+
+int main()
+{
+    test_inline(Allocator::MODE_ARENA);
+    test_inline(Allocator::MODE_TRACKING);
+    test_spill(Allocator::MODE_ARENA);
+    test_spill(Allocator::MODE_TRACKING);
+    return 0;
+}
@@ -0,0 +1,95 @@
+// XLang
+// -- A parser framework for language modeling
+// Copyright (C) 2011 onlyuser <mailto:onlyuser@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#include "XLangUnitTest.h" // CHECK
+#include "XLangTreeContext.h" // TreeContext
+#include "XLangInternTable.h" // InternPool
+#include <string> // std::string
+#include <thread> // std::thread
+#include <vector> // std::vector
+
+static void test_pool()
+{
+    xl::InternPool pool;
+    xl::Allocator alloc_1("unit_1"), alloc_2("unit_2");
+    {
+        xl::TreeContext tc_1(alloc_1, &pool);
+        tc_1.alloc_unique_string("x");
+        tc_1.alloc_unique_string("y");
+        tc_1.publish_strings();
+    }
+    alloc_1.reset(); // pool strings outlive the parse that published them
+    CHECK(pool.size() == 2);
+    xl::TreeContext tc_2(alloc_2, &pool);
+    const std::string* y = tc_2.alloc_unique_string("y");
+    CHECK(*y == "y" && xl::TreeContext::atom_id(y) == 1);
+    CHECK(xl::TreeContext::atom_id(tc_2.alloc_unique_string("z")) == 2);
+}
+
+// a context with a pool hands out the pool's strings, and interns only what is new
+static void test_pool_lookup()
+{
+    xl::InternPool pool;
+    const std::string* x = pool.alloc_unique_string("x", 1);
+    xl::Allocator alloc("unit");
+    size_t size_bytes = alloc.size();
+    xl::TreeContext tc(alloc, &pool);
+    CHECK(tc.alloc_unique_string("x") == x && alloc.size() == size_bytes);
+    const std::string* y = tc.alloc_unique_string("y");
+    CHECK(y != pool.alloc_unique_string("y", 1)); // not in the pool until published
+    CHECK(pool.size() == 2 && tc.atom_count() == 2);
+}
+
+// concurrent inserts of overlapping strings agree on one copy of each
+static void test_pool_threads()
+{
+    static const int THREAD_COUNT = 8;
+    static const int STRING_COUNT = 2000;
+    xl::InternPool pool;
+    std::vector<std::vector<const std::string*>> result_vec(THREAD_COUNT);
+    std::vector<std::thread> thread_vec;
+    for(int i = 0; i < THREAD_COUNT; i++)
+    {
+        thread_vec.push_back(std::thread([&pool, &result_vec, i]() {
+                for(int j = 0; j < STRING_COUNT; j++)
+                {
+                    std::string s = "s" + std::to_string((j*7+i)%STRING_COUNT);
+                    result_vec[i].push_back(pool.alloc_unique_string(s.data(), s.size()));
+                }
+            }));
+    }
+    for(auto p = thread_vec.begin(); p != thread_vec.end(); ++p)
+        (*p).join();
+    CHECK(pool.size() == STRING_COUNT);
+    for(int i = 0; i < THREAD_COUNT; i++)
+    {
+        for(int j = 0; j < STRING_COUNT; j++)
+        {
+            const std::string* s = result_vec[i][j];
+            CHECK(*s == "s" + std::to_string((j*7+i)%STRING_COUNT));
+            CHECK(pool.find(s->data(), s->size(), xl::hash_string(s->data(), s->size()), pool.size()) == s);
+        }
+    }
+}
+
+int main()
+{
+    test_pool();
+    test_pool_lookup();
+    test_pool_threads();
+    return 0;
+}
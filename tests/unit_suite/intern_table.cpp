@@ -0,0 +1,58 @@
+// XLang
+// -- A parser framework for language modeling
+// Copyright (C) 2011 onlyuser <mailto:onlyuser@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#include "XLangUnitTest.h" // CHECK
+#include "XLangTreeContext.h" // TreeContext
+#include <string> // std::string
+#include <vector> // std::vector
+
+static void test_unique_strings()
+{
+    xl::Allocator alloc("unit");
+    xl::TreeContext tc(alloc);
+    const std::string* x = tc.alloc_unique_string("x");
+    CHECK(*x == "x");
+    CHECK(tc.alloc_unique_string(std::string("x")) == x);
+    CHECK(tc.alloc_unique_string("xy", 1) == x); // only the given length is compared
+    CHECK(tc.alloc_unique_string("y") != x);
+    const std::string* nul = tc.alloc_unique_string("a\0b", 3);
+    CHECK(nul->size() == 3 && tc.alloc_unique_string("a\0c", 3) != nul);
+    CHECK(tc.alloc_unique_string("", 0)->empty());
+}
+
+// every string is still found once the table has grown many times
+static void test_growth()
+{
+    static const int STRING_COUNT = 20000;
+    xl::Allocator alloc("unit");
+    xl::TreeContext tc(alloc);
+    std::vector<const std::string*> string_vec;
+    for(int i = 0; i < STRING_COUNT; i++)
+        string_vec.push_back(tc.alloc_unique_string("s" + std::to_string(i)));
+    for(int i = 0; i < STRING_COUNT; i++)
+    {
+        std::string s = "s" + std::to_string(i);
+        CHECK(*string_vec[i] == s && tc.alloc_unique_string(s) == string_vec[i]);
+    }
+}
+
+int main()
+{
+    test_unique_strings();
+    test_growth();
+    return 0;
+}
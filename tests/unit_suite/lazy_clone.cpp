@@ -0,0 +1,134 @@
+// XLang
+// -- A parser framework for language modeling
+// Copyright (C) 2011 onlyuser <mailto:onlyuser@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#include "XLangUnitTest.h" // CHECK
+#include "mvc/XLangMVCModel.h" // mvc::MVCModel
+#include "node/XLangNode.h" // node::SymbolNode
+
+using namespace xl;
+
+// (- (+ (* 1 2) 3) 4)
+static node::NodeIdentIFace* make_tree(TreeContext* tc)
+{
+    return mvc::MVCModel::make_symbol(tc, '-', 2,
+            mvc::MVCModel::make_symbol(tc, '+', 2,
+                    mvc::MVCModel::make_symbol(tc, '*', 2,
+                            mvc::MVCModel::make_term(tc, 0, 1L),
+                            mvc::MVCModel::make_term(tc, 0, 2L)),
+                    mvc::MVCModel::make_term(tc, 0, 3L)),
+            mvc::MVCModel::make_term(tc, 0, 4L));
+}
+
+static node::SymbolNodeIFace* symbol(const node::NodeIdentIFace* _node)
+{
+    return const_cast<node::SymbolNodeIFace*>(node::node_cast<node::SymbolNodeIFace>(_node));
+}
+
+static node::SymbolNodeIFace* child(node::NodeIdentIFace* _node, size_t index)
+{
+    return symbol((*symbol(_node))[index]);
+}
+
+static node::SymbolNodeIFace* edit(node::NodeIdentIFace* _node, size_t index)
+{
+    return symbol(symbol(_node)->edit(index));
+}
+
+static size_t count_nodes(const node::NodeIdentIFace* _node)
+{
+    if(!_node || _node->type() != node::NodeIdentIFace::SYMBOL)
+        return 1;
+    size_t n = 1;
+    for(size_t i = 0; i<symbol(_node)->size(); i++)
+    {
+        const node::NodeIdentIFace* _child = (*symbol(_node))[i];
+        if(symbol(_node)->index_of(_child) != static_cast<int>(i))
+            return 0;
+        n += count_nodes(_child);
+    }
+    return n;
+}
+
+// reading a clone copies nothing, it sees the original's nodes
+static void test_reads_copy_nothing()
+{
+    Allocator alloc("unit");
+    TreeContext tc(alloc);
+    node::NodeIdentIFace* original = make_tree(&tc);
+    tc.set_lazy_clone(true);
+    node::NodeIdentIFace* clone = original->clone(&tc);
+    tc.set_lazy_clone(false);
+    size_t size_bytes = alloc.size();
+    CHECK(count_nodes(clone) == 7);
+    CHECK(clone->compare(original) && original->compare(clone) && clone->hash() == original->hash());
+    CHECK(symbol(clone)->find((*symbol(original))[1]) == (*symbol(original))[1]);
+    CHECK(child(child(clone, 0), 0) == child(child(original, 0), 0));
+    CHECK(alloc.size() == size_bytes);
+}
+
+// edits to the clone leave the original alone
+static void test_copy_on_write()
+{
+    Allocator alloc("unit");
+    TreeContext tc(alloc);
+    node::NodeIdentIFace* original = make_tree(&tc);
+    node::NodeIdentIFace* reference = make_tree(&tc);
+    tc.set_lazy_clone(true);
+    node::NodeIdentIFace* clone = original->clone(&tc);
+    tc.set_lazy_clone(false);
+    CHECK(symbol(clone)->size() == 2);
+    node::SymbolNodeIFace* mul = edit(edit(clone, 0), 0);
+    CHECK(mul != child(child(original, 0), 0));
+    CHECK(mul->parent()->parent() == clone && mul->index() == 0);
+    CHECK(child(clone, 0) == mul->parent() && child(child(clone, 0), 0) == mul);
+    mul->push_back(mvc::MVCModel::make_term(&tc, 0, 5L));
+    CHECK(original->compare(reference) && count_nodes(original) == 7);
+    CHECK(!clone->compare(original) && count_nodes(clone) == 8);
+
+    // a child read before the clone had its own is found by its copy
+    tc.set_lazy_clone(true);
+    clone = original->clone(&tc);
+    tc.set_lazy_clone(false);
+    node::NodeIdentIFace* four = (*symbol(clone))[1];
+    symbol(clone)->remove_first(four);
+    CHECK(symbol(clone)->size() == 1 && four->parent() == original);
+    CHECK(original->compare(reference));
+}
+
+// a hashed clone's hash stays right after an edit below it
+static void test_hash_after_edit()
+{
+    Allocator alloc("unit");
+    TreeContext tc(alloc);
+    node::NodeIdentIFace* original = make_tree(&tc);
+    tc.set_lazy_clone(true);
+    node::NodeIdentIFace* clone = original->clone(&tc);
+    tc.set_lazy_clone(false);
+    clone->hash();
+    edit(edit(clone, 0), 0)->push_back(mvc::MVCModel::make_term(&tc, 0, 5L));
+    CHECK(clone->hash() != original->hash());
+    CHECK(!clone->compare(original) && !original->compare(clone));
+    CHECK(clone->hash() == clone->clone(&tc)->hash());
+}
+
+int main()
+{
+    test_reads_copy_nothing();
+    test_copy_on_write();
+    test_hash_after_edit();
+    return 0;
+}
@@ -0,0 +1,81 @@
+// XLang
+// -- A parser framework for language modeling
+// Copyright (C) 2011 onlyuser <mailto:onlyuser@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#include "XLangUnitTest.h" // CHECK
+#include "XLangTreeContext.h" // TreeContext
+#include "XLangString.h" // InlineString
+#include "mvc/XLangMVCModel.h" // mvc::MVCModel
+#include "node/XLangNode.h" // node::TermNode
+#include <string> // std::string
+
+typedef xl::node::TermNodeIFace<xl::node::NodeIdentIFace::STRING> string_term_t;
+
+// the length and the bytes are one chunk, NUL terminated
+static void test_inline_string()
+{
+    xl::Allocator alloc("unit");
+    xl::TreeContext tc(alloc);
+    size_t size_bytes = alloc.size();
+    const xl::InlineString* s = tc.alloc_string(std::string("a\0b", 3));
+    CHECK(alloc.size()-size_bytes < xl::InlineString::alloc_size(3)+xl::Allocator::ALIGN_BYTES);
+    CHECK(s->size() == 3 && s->str() == std::string("a\0b", 3) && s->c_str()[3] == '\0');
+    CHECK(tc.alloc_string("", 0)->empty());
+    CHECK(*tc.alloc_string("lit", 3) == *tc.alloc_string(std::string("lit")));
+    CHECK(tc.alloc_string("lit", 3) != tc.alloc_string("lit", 3)); // a copy each, without dedup
+}
+
+// STRING terms compare and hash by content, and a clone shares its string
+static void test_string_terms()
+{
+    xl::Allocator alloc("unit");
+    xl::TreeContext tc(alloc);
+    xl::node::NodeIdentIFace* x_1 = xl::mvc::MVCModel::make_term(&tc, 0, tc.alloc_string("x", 1));
+    xl::node::NodeIdentIFace* x_2 = xl::mvc::MVCModel::make_term(&tc, 0, tc.alloc_string("x", 1));
+    xl::node::NodeIdentIFace* y = xl::mvc::MVCModel::make_term(&tc, 0, tc.alloc_string("y", 1));
+    CHECK(x_1->compare(x_2) && x_1->hash() == x_2->hash());
+    CHECK(!x_1->compare(y));
+    xl::node::NodeIdentIFace* x_clone = x_1->clone(&tc);
+    CHECK(xl::node::node_cast<string_term_t>(x_clone)->value() == xl::node::node_cast<string_term_t>(x_1)->value());
+}
+
+// equal literals share one copy in the root arena, until a rollback past it
+static void test_dedup()
+{
+    xl::Allocator alloc("unit");
+    xl::TreeContext tc(alloc);
+    tc.set_dedup_strings(true);
+    const xl::InlineString* lit = tc.alloc_string("lit", 3);
+    CHECK(tc.alloc_string(std::string("lit")) == lit && tc.alloc_string("lot", 3) != lit);
+    tc.push_arena();
+    const xl::InlineString* lat = tc.alloc_string("lat", 3);
+    CHECK(tc.alloc_string("lit", 3) == lit);
+    tc.pop_arena();
+    CHECK(lat->str() == "lat" && tc.alloc_string("lat", 3) == lat); // outlives the child arena
+    xl::TreeContext::mark_t m = tc.mark();
+    const xl::InlineString* new_lit = tc.alloc_string("new", 3);
+    CHECK(tc.alloc_string("new", 3) == new_lit);
+    tc.rollback(m);
+    CHECK(tc.alloc_string("new", 3)->str() == "new" && tc.alloc_string("lit", 3) == lit);
+}
+
+int main()
+{
+    test_inline_string();
+    test_string_terms();
+    test_dedup();
+    return 0;
+}
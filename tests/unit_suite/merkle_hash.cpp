@@ -0,0 +1,83 @@
+// XLang
+// -- A parser framework for language modeling
+// Copyright (C) 2011 onlyuser <mailto:onlyuser@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#include "XLangUnitTest.h" // CHECK
+#include "mvc/XLangMVCModel.h" // mvc::MVCModel
+#include "node/XLangNode.h" // node::SymbolNode
+
+using namespace xl;
+
+// (- (+ (* 1 2) 3) 4)
+static node::NodeIdentIFace* make_tree(TreeContext* tc)
+{
+    return mvc::MVCModel::make_symbol(tc, '-', 2,
+            mvc::MVCModel::make_symbol(tc, '+', 2,
+                    mvc::MVCModel::make_symbol(tc, '*', 2,
+                            mvc::MVCModel::make_term(tc, 0, 1L),
+                            mvc::MVCModel::make_term(tc, 0, 2L)),
+                    mvc::MVCModel::make_term(tc, 0, 3L)),
+            mvc::MVCModel::make_term(tc, 0, 4L));
+}
+
+static node::SymbolNodeIFace* child(node::NodeIdentIFace* _node, size_t index)
+{
+    return node::node_cast<node::SymbolNodeIFace>((*node::node_cast<node::SymbolNodeIFace>(_node))[index]);
+}
+
+static void test_equal_trees()
+{
+    Allocator alloc("unit");
+    TreeContext tc(alloc);
+    node::NodeIdentIFace* x = make_tree(&tc);
+    node::NodeIdentIFace* y = make_tree(&tc);
+    CHECK(x->hash() != 0 && x->hash() == y->hash());
+    CHECK(x->compare(y) && y->compare(x));
+    CHECK(x->clone(&tc)->hash() == x->hash());
+    CHECK(mvc::MVCModel::make_term(&tc, 0, 1L)->hash() != mvc::MVCModel::make_term(&tc, 1, 1L)->hash());
+
+    // the children's order counts
+    node::NodeIdentIFace* one = mvc::MVCModel::make_term(&tc, 0, 1L);
+    node::NodeIdentIFace* two = mvc::MVCModel::make_term(&tc, 0, 2L);
+    node::NodeIdentIFace* one_two = mvc::MVCModel::make_symbol(&tc, '-', 2, one, two);
+    node::NodeIdentIFace* two_one = mvc::MVCModel::make_symbol(&tc, '-', 2, two->clone(&tc), one->clone(&tc));
+    CHECK(one_two->hash() != two_one->hash() && !one_two->compare(two_one));
+}
+
+// a change deep down reaches the root's cached hash
+static void test_invalidate()
+{
+    Allocator alloc("unit");
+    TreeContext tc(alloc);
+    node::NodeIdentIFace* x = make_tree(&tc);
+    node::NodeIdentIFace* y = make_tree(&tc);
+    x->hash();
+    y->hash();
+    node::SymbolNodeIFace* mul = child(child(x, 0), 0);
+    mul->push_back(mvc::MVCModel::make_term(&tc, 0, 5L));
+    CHECK(x->hash() != y->hash() && !x->compare(y));
+    (*mul)[2]->detach();
+    CHECK(x->hash() == y->hash() && x->compare(y));
+    mul->erase(0);
+    CHECK(x->hash() != y->hash() && !x->compare(y));
+}
+
+int main()
+{
+    test_equal_trees();
+    test_invalidate();
+    return 0;
+}
@@ -0,0 +1,65 @@
+// XLang
+// -- A parser framework for language modeling
+// Copyright (C) 2011 onlyuser <mailto:onlyuser@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#include "XLangUnitTest.h" // CHECK
+#include "mvc/XLangMVCModel.h" // mvc::MVCModel
+#include "node/XLangNode.h" // node::SymbolNode
+
+using namespace xl;
+
+// a cast to an interface the node's type doesn't have fails, as dynamic_cast does
+static void test_cast()
+{
+    Allocator alloc("unit");
+    TreeContext tc(alloc);
+    node::NodeIdentIFace* term = mvc::MVCModel::make_term(&tc, 0, 1L);
+    node::NodeIdentIFace* symbol = mvc::MVCModel::make_symbol(&tc, 1, 1, term);
+    CHECK(node::node_cast<node::TermNodeIFace<node::NodeIdentIFace::INT>>(term)->value() == 1);
+    CHECK(node::node_cast<node::SymbolNodeIFace>(symbol)->size() == 1);
+    CHECK(node::node_cast<node::SymbolNodeIFace>(term) == NULL);
+    CHECK(node::node_cast<node::TermNodeIFace<node::NodeIdentIFace::FLOAT>>(term) == NULL);
+    CHECK(node::node_cast<node::TermNodeIFace<node::NodeIdentIFace::INT>>(symbol) == NULL);
+    CHECK(node::node_cast<node::Node>(symbol) == dynamic_cast<node::Node*>(symbol));
+}
+
+// the fast path gives the same pointer as dynamic_cast, for each term type
+template<node::NodeIdentIFace::type_t T>
+static void check_term(node::NodeIdentIFace* term)
+{
+    const node::NodeIdentIFace* const_term = term;
+    CHECK(term->type() == T);
+    CHECK(node::node_cast<node::TermNodeIFace<T>>(term) == dynamic_cast<node::TermNodeIFace<T>*>(term));
+    CHECK(node::node_cast<node::TermNodeIFace<T>>(const_term) == node::node_cast<node::TermNodeIFace<T>>(term));
+}
+
+static void test_term_types()
+{
+    Allocator alloc("unit");
+    TreeContext tc(alloc);
+    check_term<node::NodeIdentIFace::INT>(mvc::MVCModel::make_term(&tc, 0, 1L));
+    check_term<node::NodeIdentIFace::FLOAT>(mvc::MVCModel::make_term(&tc, 0, 1.5f));
+    check_term<node::NodeIdentIFace::STRING>(mvc::MVCModel::make_term(&tc, 0, tc.alloc_string("s", 1)));
+    check_term<node::NodeIdentIFace::CHAR>(mvc::MVCModel::make_term(&tc, 0, 'c'));
+    check_term<node::NodeIdentIFace::IDENT>(mvc::MVCModel::make_term(&tc, 0, tc.alloc_unique_string("x")));
+}
+
+int main()
+{
+    test_cast();
+    test_term_types();
+    return 0;
+}
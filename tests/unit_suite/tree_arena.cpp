@@ -0,0 +1,112 @@
+// XLang
+// -- A parser framework for language modeling
+// Copyright (C) 2011 onlyuser <mailto:onlyuser@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#include "XLangUnitTest.h" // CHECK
+#include "XLangAlloc.h" // Allocator
+#include "XLangTreeContext.h" // TreeContext
+#include "mvc/XLangMVCModel.h" // mvc::MVCModel
+#include "node/XLangNode.h" // node::SymbolNode
+
+using namespace xl;
+
+// (= x (+ i 1))
+static node::NodeIdentIFace* make_stmt(TreeContext* tc, long i)
+{
+    return mvc::MVCModel::make_symbol(tc, '=', 2,
+            mvc::MVCModel::make_term(tc, 0, tc->alloc_unique_string("x")),
+            mvc::MVCModel::make_symbol(tc, '+', 2,
+                    mvc::MVCModel::make_term(tc, 0, i),
+                    mvc::MVCModel::make_term(tc, 0, 1L)));
+}
+
+// a popped statement gives back everything but its unique strings
+static void test_push_pop(Allocator::mode_e mode)
+{
+    Allocator alloc("unit", mode);
+    TreeContext tc(alloc);
+    const std::string* x = tc.alloc_unique_string("x");
+    size_t size_bytes = alloc.size();
+    for(long i = 0; i < 1000; i++)
+    {
+        tc.push_arena();
+        CHECK(&tc.alloc() != &alloc && tc.alloc().parent() == &alloc);
+        make_stmt(&tc, i);
+        tc.pop_arena();
+        CHECK(&tc.alloc() == &alloc);
+        CHECK(alloc.size() == size_bytes);
+    }
+    CHECK(tc.alloc_unique_string("x") == x);
+}
+
+// a kept arena lives on in its parent
+static void test_keep(Allocator::mode_e mode)
+{
+    Allocator alloc("unit", mode);
+    TreeContext tc(alloc);
+    size_t size_bytes = alloc.size();
+    tc.push_arena();
+    node::NodeIdentIFace* stmt = make_stmt(&tc, 2);
+    tc.pop_arena(true);
+    CHECK(&tc.alloc() == &alloc && alloc.size() > size_bytes);
+    CHECK(node::node_cast<node::SymbolNodeIFace>(stmt)->size() == 2);
+    CHECK(make_stmt(&tc, 2)->compare(stmt));
+}
+
+// a rollback past a push releases the arena and what was built in it
+static void test_rollback(Allocator::mode_e mode)
+{
+    Allocator alloc("unit", mode);
+    TreeContext tc(alloc);
+    tc.alloc_unique_string("x");
+    size_t size_bytes = alloc.size();
+    TreeContext::mark_t m = tc.mark();
+    tc.push_arena();
+    make_stmt(&tc, 1);
+    tc.push_arena();
+    make_stmt(&tc, 2);
+    tc.rollback(m);
+    CHECK(&tc.alloc() == &alloc && alloc.size() == size_bytes);
+}
+
+// hash-consed nodes built in a popped arena are no longer found
+static void test_hash_cons(Allocator::mode_e mode)
+{
+    Allocator alloc("unit", mode);
+    TreeContext tc(alloc);
+    tc.set_hash_cons(true);
+    node::NodeIdentIFace* one = mvc::MVCModel::make_term(&tc, 0, 1L);
+    tc.push_arena();
+    node::NodeIdentIFace* stmt = make_stmt(&tc, 1);
+    CHECK((*node::node_cast<node::SymbolNodeIFace>(
+            (*node::node_cast<node::SymbolNodeIFace>(stmt))[1]))[1] == one);
+    tc.pop_arena();
+    CHECK(mvc::MVCModel::make_term(&tc, 0, 1L) == one);
+    CHECK(node::node_cast<node::SymbolNodeIFace>(make_stmt(&tc, 1))->size() == 2);
+}
+
+int main()
+{
+    test_push_pop(Allocator::MODE_ARENA);
+    test_push_pop(Allocator::MODE_TRACKING);
+    test_keep(Allocator::MODE_ARENA);
+    test_keep(Allocator::MODE_TRACKING);
+    test_rollback(Allocator::MODE_ARENA);
+    test_rollback(Allocator::MODE_TRACKING);
+    test_hash_cons(Allocator::MODE_ARENA);
+    test_hash_cons(Allocator::MODE_TRACKING);
+    return 0;
+}
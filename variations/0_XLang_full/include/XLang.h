@@ -66,8 +66,11 @@ struct ScannerContext
 class ParserContext
 {
 public:
-    ParserContext(xl::Allocator &alloc, const char* buf)
-        : m_tree_context(alloc), m_scanner_context(buf)
+    // takes each statement as soon as it is parsed, see make_ast
+    typedef void (*stmt_cb_t)(const xl::node::NodeIdentIFace* stmt, void* arg);
+
+    ParserContext(xl::Allocator &alloc, const char* buf, stmt_cb_t stmt_cb = NULL, void* stmt_arg = NULL)
+        : m_tree_context(alloc), m_scanner_context(buf), m_stmt_cb(stmt_cb), m_stmt_arg(stmt_arg)
     {}
     xl::TreeContext &tree_context()
     {
@@ -77,10 +80,20 @@ public:
     {
         return m_scanner_context;
     }
+    stmt_cb_t stmt_cb() const
+    {
+        return m_stmt_cb;
+    }
+    void* stmt_arg() const
+    {
+        return m_stmt_arg;
+    }
 
 private:
     xl::TreeContext m_tree_context;
     ScannerContext  m_scanner_context;
+    stmt_cb_t       m_stmt_cb;
+    void*           m_stmt_arg;
 };
 #define YY_EXTRA_TYPE ParserContext*
 
@@ -97,6 +110,7 @@ void yyerror(const char* s);
 std::stringstream &error_messages();
 std::string id_to_name(uint32_t lexer_id);
 
-xl::node::NodeIdentIFace* make_ast(xl::Allocator &alloc, char* s);
+xl::node::NodeIdentIFace* make_ast(xl::Allocator &alloc, const char* s,
+        ParserContext::stmt_cb_t stmt_cb = NULL, void* stmt_arg = NULL);
 
 #endif
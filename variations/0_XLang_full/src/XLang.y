@@ -119,6 +119,18 @@ uint32_t name_to_id(std::string name)
     return 0;
 }
 
+// Without a statement callback, returns stmt for the program tree. Else hands it to the
+// callback and releases it with its arena, then pushes the next statement's arena.
+xl::node::NodeIdentIFace* emit_stmt(ParserContext* pc, xl::node::NodeIdentIFace* stmt)
+{
+    if(!pc->stmt_cb())
+        return stmt;
+    pc->stmt_cb()(stmt, pc->stmt_arg());
+    pc->tree_context().pop_arena();
+    pc->tree_context().push_arena();
+    return NULL;
+}
+
 %}
 
 // 'pure_parser' tells bison to use no global variables and create a
@@ -155,8 +167,8 @@ root:
     ;
 
 program:
-      stmt             { $$ = $1; }
-    | program ',' stmt { $$ = MAKE_SYMBOL(',', @$, 2, $1, $3); }
+      stmt             { $$ = emit_stmt(pc, $1); }
+    | program ',' stmt { $$ = pc->stmt_cb() ? emit_stmt(pc, $3) : MAKE_SYMBOL(',', @$, 2, $1, $3); }
     ;
 
 stmt:
@@ -185,13 +197,20 @@ ScannerContext::ScannerContext(const char* buf)
       m_line(1), m_column(1), m_prev_column(1)
 {}
 
-xl::node::NodeIdentIFace* make_ast(xl::Allocator &alloc, const char* s)
+// With a statement callback, each statement is built in its own child arena, and released
+// once the callback returns. The program tree is not kept, so NULL is returned.
+xl::node::NodeIdentIFace* make_ast(xl::Allocator &alloc, const char* s,
+        ParserContext::stmt_cb_t stmt_cb, void* stmt_arg)
 {
-    ParserContext parser_context(alloc, s);
+    ParserContext parser_context(alloc, s, stmt_cb, stmt_arg);
     yyscan_t scanner = parser_context.scanner_context().m_scanner;
     yylex_init(&scanner);
     yyset_extra(&parser_context, scanner);
+    if(stmt_cb)
+        parser_context.tree_context().push_arena();
     int error_code = yyparse(&parser_context, scanner); // parser entry point
+    if(stmt_cb)
+        parser_context.tree_context().pop_arena();
     yylex_destroy(scanner); // NOTE: necessary to avoid memory leak
     return (!error_code && error_messages().str().empty()) ? parser_context.tree_context().root() : NULL;
 }
@@ -212,6 +231,7 @@ void display_usage(bool verbose)
                 << "  -x, --xml" << std::endl
                 << "  -g, --graph" << std::endl
                 << "  -d, --dot" << std::endl
+                << "  -s, --stream (print each statement as soon as it is parsed)" << std::endl
                 << "  -m, --memory" << std::endl
                 << "  -h, --help" << std::endl;
     }
@@ -234,10 +254,11 @@ struct options_t
     mode_e      mode;
     std::string in_xml;
     std::string expr;
+    bool        stream;
     bool        dump_memory;
 
     options_t()
-        : mode(MODE_NONE), dump_memory(false)
+        : mode(MODE_NONE), stream(false), dump_memory(false)
     {}
 };
 
@@ -247,7 +268,7 @@ bool extract_options_from_args(options_t* options, int argc, char** argv)
         return false;
     int opt = 0;
     int longIndex = 0;
-    static const char *optString = "i:e:lxgdmh?";
+    static const char *optString = "i:e:lxgdsmh?";
     static const struct option longOpts[] = {
                 { "in-xml", required_argument, NULL, 'i' },
                 { "expr",   required_argument, NULL, 'e' },
@@ -255,6 +276,7 @@ bool extract_options_from_args(options_t* options, int argc, char** argv)
                 { "xml",    no_argument,       NULL, 'x' },
                 { "graph",  no_argument,       NULL, 'g' },
                 { "dot",    no_argument,       NULL, 'd' },
+                { "stream", no_argument,       NULL, 's' },
                 { "memory", no_argument,       NULL, 'm' },
                 { "help",   no_argument,       NULL, 'h' },
                 { NULL,     no_argument,       NULL, 0 }
@@ -270,6 +292,7 @@ bool extract_options_from_args(options_t* options, int argc, char** argv)
             case 'x': options->mode = options_t::MODE_XML; break;
             case 'g': options->mode = options_t::MODE_GRAPH; break;
             case 'd': options->mode = options_t::MODE_DOT; break;
+            case 's': options->stream = true; break;
             case 'm': options->dump_memory = true; break;
             case 'h':
             case '?': options->mode = options_t::MODE_HELP; break;
@@ -282,6 +305,8 @@ bool extract_options_from_args(options_t* options, int argc, char** argv)
     return options->mode != options_t::MODE_NONE || options->dump_memory;
 }
 
+void export_stmt(const xl::node::NodeIdentIFace* stmt, void* arg);
+
 bool import_ast(options_t &options, xl::Allocator &alloc, xl::node::NodeIdentIFace* &ast)
 {
     if(options.in_xml.size())
@@ -297,8 +322,8 @@ bool import_ast(options_t &options, xl::Allocator &alloc, xl::node::NodeIdentIFa
     }
     else
     {
-        ast = make_ast(alloc, options.expr.c_str());
-        if(!ast)
+        ast = make_ast(alloc, options.expr.c_str(), options.stream ? export_stmt : NULL, &options);
+        if(!ast && !(options.stream && error_messages().str().empty())) // a stream returns no tree
         {
             std::cerr << "ERROR: " << error_messages().str().c_str() << std::endl;
             return false;
@@ -320,6 +345,11 @@ void export_ast(options_t &options, const xl::node::NodeIdentIFace* ast)
     }
 }
 
+void export_stmt(const xl::node::NodeIdentIFace* stmt, void* arg)
+{
+    export_ast(*static_cast<options_t*>(arg), stmt);
+}
+
 bool apply_options(options_t &options)
 {
     try
@@ -329,11 +359,13 @@ bool apply_options(options_t &options)
             display_usage(true);
             return true;
         }
-        xl::Allocator alloc(__FILE__);
+        xl::Allocator alloc(__FILE__, options.dump_memory ?
+                xl::Allocator::MODE_TRACKING : xl::Allocator::MODE_ARENA);
         xl::node::NodeIdentIFace* ast = NULL;
         if(!import_ast(options, alloc, ast))
             return false;
-        export_ast(options, ast);
+        if(ast)
+            export_ast(options, ast);
         if(options.dump_memory)
             alloc.dump(std::string(1, '\t'));
     }
@@ -321,7 +321,8 @@ bool apply_options(options_t &options)
             display_usage(true);
             return true;
         }
-        xl::Allocator alloc(__FILE__);
+        xl::Allocator alloc(__FILE__, options.dump_memory ?
+                xl::Allocator::MODE_TRACKING : xl::Allocator::MODE_ARENA);
         xl::node::NodeIdentIFace* ast = NULL;
         if(!import_ast(options, alloc, ast))
             return false;